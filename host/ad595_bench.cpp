@@ -0,0 +1,511 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: ad595_bench.cpp
+ * Function: AD595 conversion micro-benchmark
+ * Description: Times the double conversion used by the original AD595::tempC()/tempF() against
+ *              the fixed point rawToCentiC()/rawToCentiF() path, per conversion, on the host.
+ *              Before timing, it checks the conversions, oversampling, read(), the scanner's
+ *              channel rotation and background acquisition against the simulated analog inputs,
+ *              and the step response and spike rejection of the AD595Filter.h filters.
+ *              These numbers can't rank the two paths for AVR: the host has a hardware FPU and
+ *              a 64 bit multiplier, while AVR has neither, and every double operation there is
+ *              a soft-float library call. They only track regressions in either path; judge
+ *              AVR cost from cycle counts of an avr-gcc build.
+ *              It also streams a simulated four channel log through AD595Telemetry into
+ *              build/ad595_telemetry.bin, with the CSV ad595_decode should turn it back into in
+ *              build/ad595_telemetry.expected, and compares its size against the text output
+ *              of the serial demo. Finally it checks AD595Logger's rolling minimum, maximum
+ *              and mean against a brute force scan of the same readings and times add().
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "host.h"
+#include "AD595.h"
+#include "AD595Telemetry.h"
+#include "AD595Logger.h"
+#include "AD595Filter.h"
+
+#define ROUNDS 20000
+
+static volatile double sink_d;
+static volatile int32_t sink_i;
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// the original formulas, kept here for comparison. noinline keeps the compiler from
+// vectorizing the benchmark loops, which an AVR build couldn't do either
+static __attribute__((noinline)) double legacy_tempC(uint16_t raw) {
+  return (5.0 * raw * 100.0) / 1024.0;
+}
+
+static __attribute__((noinline)) double legacy_tempF(uint16_t raw) {
+  return ((legacy_tempC(raw) * 9.0/5.0) + 32);
+}
+
+static void report(const char *name, uint64_t start, uint64_t end, 
+                   double count = ROUNDS * 1024.0, const char *what = "conversion") {
+  printf("%-28s %8.2f %s/%s\n", name, (double)(end - start) / count,
+#if defined(__x86_64__) || defined(__i386__)
+         "cycles", what);
+#else
+         "ns", what);
+#endif
+}
+
+// analog input that counts up by one on every conversion, so each sample is distinguishable
+static int counter_level;
+
+static int counter(uint8_t, unsigned long) {
+  return counter_level++;
+}
+
+// summing 4^n conversions and shifting by n must give the mean with n extra bits, and the
+// fixed point scaling must follow the extra bits
+static int oversampling() {
+  AD595 thermocouple;
+  unsigned long reads;
+  uint16_t raw;
+  int32_t want;
+  
+  host_reset();
+  host_setAnalogFunction(0, counter);
+  thermocouple.init(A0);
+  
+  for (uint8_t bits = 0; bits <= 3; bits++) {
+    thermocouple.setOversampling(bits);
+    counter_level = 100;
+    reads = host_analogReads();
+    raw = thermocouple.sample();
+    // the mean of 100 .. 100 + 4^bits - 1, scaled up by 2^bits
+    want = (100 * 2 + (1 << (2 * bits)) - 1) << bits >> 1;
+    if (host_analogReads() - reads != 1UL << (2 * bits) || raw != want) {
+      printf("oversampling %u: %u from %lu conversions, expected %ld from %lu\n", bits, raw, 
+             host_analogReads() - reads, (long)want, 1UL << (2 * bits));
+      return 1;
+    }
+    want = (int32_t)((double)raw * 50000.0 / (1024 << bits) + 0.5);
+    if (thermocouple.rawToCentiC(raw) != want) {
+      printf("oversampling %u: %u is %ld, expected %ld\n", bits, raw, (long)thermocouple.rawToCentiC(raw), (long)want);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// read() takes one sample and derives both units from it
+static int single_read() {
+  AD595 thermocouple;
+  AD595Reading reading;
+  unsigned long reads;
+  
+  host_reset();
+  host_setAnalogFunction(0, counter);
+  thermocouple.init(A0);
+  
+  for (counter_level = 0; counter_level < 1024; ) {
+    reads = host_analogReads();
+    reading = thermocouple.read();
+    if (host_analogReads() - reads != 1 || reading.raw != counter_level - 1 ||
+        reading.centiC != thermocouple.rawToCentiC(reading.raw) ||
+        reading.centiF != thermocouple.rawToCentiF(reading.raw)) {
+      printf("read at %d: raw %u, %ld/%ld from %lu conversions\n", counter_level - 1, reading.raw, 
+             (long)reading.centiC, (long)reading.centiF, host_analogReads() - reads);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// analog inputs that log which pin was converted and read back as 100 times the pin + 1
+static uint8_t scan_order[16];
+static uint8_t scan_count;
+
+static int scanned(uint8_t pin, unsigned long) {
+  if (scan_count < sizeof(scan_order)) scan_order[scan_count++] = pin;
+  return 100 * (pin + 1);
+}
+
+// the scanner converts its channels in order, one per poll(), and owns the ADC while it runs
+static int scanner() {
+  static const uint8_t pins[] = { A2, A0, A5 };
+  AD595Array<3> array;
+  AD595Array<3> other;
+  AD595Scanner empty;
+  AD595 sensor;
+  uint8_t i;
+  
+  host_reset();
+  for (i = 0; i < 3; i++) host_setAnalogFunction(pins[i], scanned);
+  array.init(pins);
+  other.init(pins);
+  sensor.init(A1);
+  scan_count = 0;
+  
+  if (empty.begin() || !array.begin() || other.begin() || sensor.beginBackground()) {
+    printf("scanner: ADC ownership not enforced\n");
+    return 1;
+  }
+  for (i = 0; i < 7; i++) array.poll();
+  other.poll();                        // not the owner, converts nothing
+  
+  for (i = 0; i < scan_count; i++) {
+    if (scan_order[i] != pins[i % 3] - A0) {
+      printf("scanner: conversion %u on pin %u, expected %u\n", i, scan_order[i], pins[i % 3] - A0);
+      return 1;
+    }
+  }
+  if (scan_count != 7 || array.sweeps() != 2) {
+    printf("scanner: %u conversions and %lu sweeps from 7 polls\n", scan_count, array.sweeps());
+    return 1;
+  }
+  for (i = 0; i < 3; i++) {
+    if (array.raw(i) != 100 * (pins[i] - A0 + 1) || array.read(i).centiC != AD595::scaleCentiC(array.raw(i), 0)) {
+      printf("scanner: channel %u read %u\n", i, array.raw(i));
+      return 1;
+    }
+  }
+  if (array.raw(3) || array.read(3).time || array.read(3).raw) {
+    printf("scanner: channel beyond channels() isn't empty\n");
+    return 1;
+  }
+  
+  array.end();
+  if (!other.begin()) {
+    printf("scanner: ADC not released by end()\n");
+    return 1;
+  }
+  other.end();
+  return 0;
+}
+
+// background acquisition oversamples, averages the last AD595_RING_SIZE results and owns the ADC
+static int background() {
+  static const uint16_t steps[] = { 802, 804, 806, 808, 808 };
+  static const uint8_t pins[] = { A0 };
+  AD595 thermocouple;
+  AD595 other;
+  AD595Array<1> array;
+  AD595Reading reading;
+  unsigned long reads;
+  
+  host_reset();
+  host_setAnalog(3, HOST_CONSTANT, 400);
+  thermocouple.init(A3);
+  thermocouple.setOversampling(1);
+  other.init(A4);
+  array.init(pins);
+  
+  if (!thermocouple.beginBackground() || other.beginBackground() || array.begin()) {
+    printf("background: ADC ownership not enforced\n");
+    return 1;
+  }
+  
+  // the first result primes the ring, then a step walks through it
+  reading = thermocouple.read();
+  if (reading.raw != 800) {
+    printf("background: first reading %u, expected 800\n", reading.raw);
+    return 1;
+  }
+  host_setAnalog(3, HOST_CONSTANT, 404);
+  for (uint8_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+    reads = host_analogReads();
+    reading = thermocouple.read();
+    if (host_analogReads() - reads != 4 || reading.raw != steps[i] || 
+        reading.centiC != thermocouple.rawToCentiC(reading.raw)) {
+      printf("background: step %u read %u from %lu conversions, expected %u from 4\n", i, reading.raw,
+             host_analogReads() - reads, steps[i]);
+      return 1;
+    }
+  }
+  thermocouple.endBackground();
+  reads = host_analogReads();
+  if (thermocouple.sample() != 808 || host_analogReads() - reads != 4 || !array.begin()) {
+    printf("background: not released by endBackground()\n");
+    return 1;
+  }
+  array.end();
+  return 0;
+}
+
+// feeds a filter 100 until settled, then the given input, and compares every output
+template <class FILTER>
+static int response(const char *name, const uint16_t *input, const uint16_t *want, uint8_t count) {
+  FILTER filter;
+  uint16_t out;
+  
+  for (uint8_t i = 0; i < 64; i++) filter.update(100);
+  for (uint8_t i = 0; i < count; i++) {
+    out = filter.update(input[i]);
+    if (out != want[i]) {
+      printf("%s: output %u is %u, expected %u\n", name, i, out, want[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// step response and spike rejection of each filter, and AD595Filtered behind an AD595&
+static int filters() {
+  static const uint16_t step[] = { 500, 500, 500, 500, 500, 500 };
+  static const uint16_t spike[] = { 900, 100, 100, 100, 100, 100 };
+  static const uint16_t spike2[] = { 900, 900, 100, 100, 100, 100 };
+  static const uint16_t ema[] = { 200, 275, 331, 374, 405, 429 };
+  static const uint16_t average[] = { 200, 300, 400, 500, 500, 500 };
+  static const uint16_t median3[] = { 100, 500, 500, 500, 500, 500 };
+  static const uint16_t median5[] = { 100, 100, 500, 500, 500, 500 };
+  static const uint16_t flat[] = { 100, 100, 100, 100, 100, 100 };
+  AD595Filtered< AD595MovingAverage<4> > filtered;
+  AD595 &thermocouple = filtered;
+  uint16_t out;
+  
+  if (response< AD595EMA<2> >("AD595EMA<2> step", step, ema, 6) ||
+      response< AD595MovingAverage<4> >("AD595MovingAverage<4> step", step, average, 6) ||
+      response< AD595Median<3> >("AD595Median<3> step", step, median3, 6) ||
+      response< AD595Median<5> >("AD595Median<5> step", step, median5, 6) ||
+      response< AD595Median<3> >("AD595Median<3> spike", spike, flat, 6) ||
+      response< AD595Median<5> >("AD595Median<5> double spike", spike2, flat, 6) ||
+      response< AD595Chain< AD595Median<3>, AD595MovingAverage<4> > >("AD595Chain spike", spike, flat, 6))
+    return 1;
+  
+  // a long step settles on the input exactly, without overshoot
+  {
+    AD595EMA<4> filter;
+    uint16_t last = 100;
+    
+    for (uint8_t i = 0; i < 64; i++) filter.update(100);
+    for (uint8_t i = 0; i < 200; i++) {
+      out = filter.update(500);
+      if (out < last || out > 500) {
+        printf("AD595EMA<4> step: output %u is %u after %u\n", i, out, last);
+        return 1;
+      }
+      last = out;
+    }
+    if (last != 500) {
+      printf("AD595EMA<4> step: settled at %u\n", last);
+      return 1;
+    }
+  }
+  
+  host_reset();
+  host_setAnalog(0, HOST_CONSTANT, 100);
+  filtered.init(A0);
+  for (uint8_t i = 0; i < 8; i++) thermocouple.read();
+  host_setAnalog(0, HOST_CONSTANT, 500);
+  for (uint8_t i = 0; i < 6; i++) {
+    out = thermocouple.read().raw;
+    if (out != average[i]) {
+      printf("AD595Filtered through AD595&: reading %u is %u, expected %u\n", i, out, average[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// a Print into a file, for the telemetry stream
+class FilePrint : public Print {
+  public:
+    FilePrint(FILE *file) : bytes(0), _file(file) {}
+    
+    size_t write(uint8_t value) { bytes++; return putc(value, _file) == EOF ? 0 : 1; }
+    
+    unsigned long bytes;
+    
+  private:
+    FILE *_file;
+};
+
+// four thermocouples at 200Hz each for ten seconds, warming slowly with a little noise
+static int telemetry() {
+  FILE *bin = fopen("build/ad595_telemetry.bin", "wb");
+  FILE *csv = fopen("build/ad595_telemetry.expected", "w");
+  unsigned long text = 0;
+  AD595Reading reading;
+  char line[32];
+  
+  if (!bin || !csv) {
+    perror("build/ad595_telemetry");
+    return 1;
+  }
+  
+  FilePrint out(bin);
+  AD595Telemetry telemetry(out);
+  
+  srand(1);
+  fprintf(csv, "time_ms,channel,temp_c\n");
+  for (unsigned long ms = 0; ms < 10000; ms += 5) {
+    for (uint8_t channel = 0; channel < 4; channel++) {
+      reading.time = ms;
+      reading.centiC = 2000 + channel * 5000 + ms / 4 + rand() % 50 - 25;
+      telemetry.add(channel, reading);
+      fprintf(csv, "%lu,%u,%.1f\n", ms, channel, ((reading.centiC + 5) / 10) / 10.0);
+      text += snprintf(line, sizeof(line), "C = %.2f\r\n", reading.centiC / 100.0);
+    }
+  }
+  telemetry.flush();
+  fclose(bin);
+  fclose(csv);
+  
+  printf("%-30s %6.2f bytes/record in %lu frames, %.2f as text\n", "telemetry", 
+         (double)out.bytes / telemetry.records(), telemetry.frames(), (double)text / telemetry.records());
+  return 0;
+}
+
+static long divRound(long sum, long count) {
+  return (sum + (sum < 0 ? -count : count) / 2) / count;
+}
+
+// brute force min/max/mean over readings in [from, to), mean of per second means
+static AD595Summary scan(const int16_t *log, unsigned long from, unsigned long to) {
+  AD595Summary s = { 32767, -32768, 0, 0 };
+  long sum = 0;
+  
+  for (unsigned long second = from / 1000; second < to / 1000; second++) {
+    long secondSum = 0;
+    for (unsigned long i = second * 50; i < (second + 1) * 50; i++) {
+      if (log[i] < s.min) s.min = log[i];
+      if (log[i] > s.max) s.max = log[i];
+      secondSum += log[i];
+    }
+    sum += divRound(secondSum, 50);
+    s.count++;
+  }
+  s.mean = divRound(sum, s.count);
+  return s;
+}
+
+// a random walk read at 50Hz for half an hour, checked against scan() every second
+template <uint8_t SLOTS>
+static int logger() {
+  static int16_t log[30 * 60 * 50];
+  AD595Logger<SLOTS> logger;
+  AD595Summary got, want;
+  unsigned long ms, end;
+  unsigned long i;
+  int16_t value = 250;
+  uint64_t start;
+  
+  srand(2);
+  for (i = 0; i < sizeof(log) / sizeof(log[0]); i++) {
+    value += rand() % 21 - 10;
+    log[i] = value;
+  }
+  
+  for (i = 0; i < sizeof(log) / sizeof(log[0]); i++) {
+    ms = i * 20;
+    logger.add(log[i], ms);
+    if (ms % 1000) continue;
+    
+    for (uint8_t tier = AD595_LOG_1MIN; tier <= AD595_LOG_10MIN; tier++) {
+      unsigned long span = tier == AD595_LOG_1MIN ? 60000 : 600000;
+      end = ms / (span / SLOTS) * (span / SLOTS);
+      if (end < span) continue;
+      got = logger.summary(tier);
+      want = scan(log, end - span, end);
+      // slot means are rounded on the way up, so the mean may be a tenth out
+      if (got.min != want.min || got.max != want.max || got.mean < want.mean - 1 || got.mean > want.mean + 1) {
+        printf("logger<%u> tier %u at %lums: %d/%d/%d, expected %d/%d/%d\n", SLOTS, tier, ms, 
+               got.min, got.mean, got.max, want.min, want.mean, want.max);
+        return 1;
+      }
+    }
+  }
+  
+  start = cycles();
+  for (i = 0; i < sizeof(log) / sizeof(log[0]); i++) logger.add(log[i], 1800000UL + i * 20);
+  report(SLOTS == 60 ? "AD595Logger<60> add" : "AD595Logger<20> add", start, cycles(), 
+         sizeof(log) / sizeof(log[0]), "reading");
+  return 0;
+}
+
+int main() {
+  AD595 thermocouple;
+  uint64_t start;
+  uint16_t raw;
+  long i;
+
+  thermocouple.init(0);
+
+  // the two paths must agree to within rounding before timing them
+  for (raw = 0; raw < 1024; raw++) {
+    if (thermocouple.rawToCentiC(raw) != (int32_t)(legacy_tempC(raw) * 100.0 + 0.5) ||
+        thermocouple.rawToCentiF(raw) != (int32_t)(legacy_tempF(raw) * 100.0 + 0.5)) {
+      printf("mismatch at raw %u\n", raw);
+      return 1;
+    }
+  }
+
+  // the linearization table must hit every datasheet point (Vout in tenths of a mV) exactly
+  {
+    static const uint16_t vout[] = { 27, 5030, 10157, 15206, 20152, 25136, 30220, 35374, 40577, 45817, 51080 };
+    for (i = 0; i < (long)(sizeof(vout) / sizeof(vout[0])); i++) {
+      if (AD595::linearizeCentiC(vout[i]) < i * 5000 - 1 || AD595::linearizeCentiC(vout[i]) > i * 5000 + 1) {
+        printf("linearization off at %ldC: %ld\n", i * 50, (long)AD595::linearizeCentiC(vout[i]));
+        return 1;
+      }
+    }
+  }
+
+  // a calibration through two readings maps them onto the given temperatures
+  thermocouple.setCalibration(thermocouple.rawToCentiC(3), 0, thermocouple.rawToCentiC(201), 10000);
+  if (thermocouple.rawToCentiC(3) != 0 || thermocouple.rawToCentiC(201) != 10000) {
+    printf("calibration off: %ld %ld\n", (long)thermocouple.rawToCentiC(3), (long)thermocouple.rawToCentiC(201));
+    return 1;
+  }
+  thermocouple.clearCalibration();
+
+  // a reference beyond AD595_MAX_REF_MV is clamped, so full scale can't wrap the output
+  thermocouple.setReference(AD595_REF_EXTERNAL, 9000);
+  thermocouple.setOversampling(AD595_MAX_OVERSAMPLING);
+  if (thermocouple.reference() != AD595_MAX_REF_MV || 
+      thermocouple.rawToCentiC(65535) != (int32_t)(65535.0 * AD595_MAX_REF_MV * 10 / 65536 + 0.5)) {
+    printf("reference not clamped: %u, full scale %ld\n", thermocouple.reference(), (long)thermocouple.rawToCentiC(65535));
+    return 1;
+  }
+  thermocouple.setOversampling(0);
+  thermocouple.setReference(AD595_REF_VCC);
+
+  start = cycles();
+  for (i = 0; i < ROUNDS; i++)
+    for (raw = 0; raw < 1024; raw++) sink_d = legacy_tempC(raw);
+  report("double tempC", start, cycles());
+
+  start = cycles();
+  for (i = 0; i < ROUNDS; i++)
+    for (raw = 0; raw < 1024; raw++) sink_d = legacy_tempF(raw);
+  report("double tempF", start, cycles());
+
+  start = cycles();
+  for (i = 0; i < ROUNDS; i++)
+    for (raw = 0; raw < 1024; raw++) sink_i = thermocouple.rawToCentiC(raw);
+  report("fixed point rawToCentiC", start, cycles());
+
+  start = cycles();
+  for (i = 0; i < ROUNDS; i++)
+    for (raw = 0; raw < 1024; raw++) sink_i = thermocouple.rawToCentiF(raw);
+  report("fixed point rawToCentiF", start, cycles());
+
+  thermocouple.setLinearization(true);
+  start = cycles();
+  for (i = 0; i < ROUNDS; i++)
+    for (raw = 0; raw < 1024; raw++) sink_i = thermocouple.rawToCentiC(raw);
+  report("linearized rawToCentiC", start, cycles());
+  
+  if (oversampling() || single_read() || scanner() || background() || filters()) return 1;
+  if (telemetry()) return 1;
+  if (logger<60>() || logger<20>()) return 1;
+
+  return 0;
+}
@@ -0,0 +1,116 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: ad595_decode.cpp
+ * Function: AD595 telemetry decoder
+ * Description: Turns an AD595Telemetry stream (see library/AD595/AD595Telemetry.h) back into
+ *              CSV, one line per record:
+ *
+ *                time_ms,channel,temp_c
+ *
+ *              Reads the file named on the command line, or standard input, e.g. straight
+ *              from the serial port:
+ *
+ *                stty -F /dev/ttyACM0 115200 raw && ./build/ad595_decode /dev/ttyACM0
+ *
+ *              Frames with a bad length, version or CRC are skipped and counted on stderr;
+ *              decoding carries on at the next frame.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define VERSION 1
+#define FRAME_MAX 256
+
+static unsigned long frames, records, bad;
+
+static uint16_t crc16(const uint8_t *data, int length) {
+  uint16_t crc = 0xFFFF;
+
+  while (length--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (int bit = 0; bit < 8; bit++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+// undo COBS in place, returns the decoded length or -1
+static int unstuff(uint8_t *buf, int length) {
+  uint8_t out[FRAME_MAX];
+  int in = 0, n = 0;
+
+  while (in < length) {
+    int code = buf[in++];
+    if (!code || in + code - 1 > length) return -1;
+    for (int i = 1; i < code; i++) out[n++] = buf[in++];
+    if (code < 0xFF && in < length) out[n++] = 0;
+  }
+  for (int i = 0; i < n; i++) buf[i] = out[i];
+  return n;
+}
+
+static bool varint(const uint8_t *buf, int end, int *pos, uint32_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (*pos >= end) return false;
+    uint8_t b = buf[(*pos)++];
+    *value |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+static void frame(uint8_t *buf, int length) {
+  int16_t last[256] = { 0 };
+  uint32_t time, dt, zigzag;
+  int pos = 5, end;
+
+  length = unstuff(buf, length);
+  if (length < 7 || buf[0] != VERSION ||
+      crc16(buf, length - 2) != (buf[length - 2] | buf[length - 1] << 8)) {
+    bad++;
+    return;
+  }
+  end = length - 2;
+  time = buf[1] | buf[2] << 8 | buf[3] << 16 | (uint32_t)buf[4] << 24;
+
+  while (pos < end) {
+    uint8_t channel = buf[pos++];
+    if (!varint(buf, end, &pos, &dt) || !varint(buf, end, &pos, &zigzag)) {
+      bad++;
+      return;
+    }
+    time += dt;
+    last[channel] += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    printf("%lu,%u,%.1f\n", (unsigned long)time, channel, last[channel] / 10.0);
+    records++;
+  }
+  frames++;
+}
+
+int main(int argc, char **argv) {
+  FILE *in = stdin;
+  uint8_t buf[FRAME_MAX];
+  int length = 0;
+  int c;
+
+  if (argc > 1 && !(in = fopen(argv[1], "rb"))) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  printf("time_ms,channel,temp_c\n");
+  while ((c = getc(in)) != EOF) {
+    if (c) {
+      if (length < FRAME_MAX) buf[length] = c;
+      length++;
+      continue;
+    }
+    if (length > FRAME_MAX) bad++;
+    else if (length) frame(buf, length);
+    length = 0;
+  }
+
+  fprintf(stderr, "%lu frames, %lu records, %lu bad frames\n", frames, records, bad);
+  return bad ? 2 : 0;
+}
@@ -0,0 +1,184 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: Arduino.cpp
+ * Function: Host-side Arduino core stand-in
+ * Description: Virtual clock, scripted analog inputs and Serial.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host.h"
+
+#define HOST_PINS 16
+
+struct AnalogScript {
+  uint8_t shape;
+  int level;
+  int amplitude;
+  unsigned long period;
+  uint8_t noise;
+  host_waveform fn;
+};
+
+static unsigned long long clock_us = 0;
+static AnalogScript analog[HOST_PINS];
+static unsigned long analog_reads = 0;
+static uint32_t noise_state = 1;
+
+HardwareSerial Serial;
+
+void host_resetWire();
+
+/*-----------------------------------------------------------------------------------------------
+ * Clock
+ * ----------------------------------------------------------------------------------------------*/
+void host_reset() {
+  clock_us = 0;
+  analog_reads = 0;
+  noise_state = 1;
+  memset(analog, 0, sizeof(analog));
+  for (uint8_t i = 0; i < HOST_PINS; i++) analog[i].level = 512;
+  host_resetWire();
+}
+
+void host_advance(unsigned long us) {
+  clock_us += us;
+}
+
+unsigned long long host_time() {
+  return clock_us;
+}
+
+unsigned long millis() {
+  clock_us++;
+  return clock_us / 1000;
+}
+
+unsigned long micros() {
+  clock_us++;
+  return (unsigned long)clock_us;
+}
+
+void delay(unsigned long ms) {
+  clock_us += (unsigned long long)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+  clock_us += us;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Pins
+ * ----------------------------------------------------------------------------------------------*/
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t, uint8_t) {
+}
+
+int digitalRead(uint8_t) {
+  return HIGH;
+}
+
+void analogReference(uint8_t) {
+}
+
+void attachInterrupt(uint8_t, void (*)(void), int) {
+}
+
+void detachInterrupt(uint8_t) {
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Analog inputs
+ * ----------------------------------------------------------------------------------------------*/
+void host_setAnalog(uint8_t pin, uint8_t shape, int level, int amplitude,
+                    unsigned long period_ms, uint8_t noise) {
+  if (pin >= A0) pin -= A0;
+  if (pin >= HOST_PINS) return;
+  analog[pin].shape = shape;
+  analog[pin].level = level;
+  analog[pin].amplitude = amplitude;
+  analog[pin].period = period_ms ? period_ms * 1000 : 1;
+  analog[pin].noise = noise;
+  analog[pin].fn = NULL;
+}
+
+void host_setAnalogFunction(uint8_t pin, host_waveform fn) {
+  if (pin >= A0) pin -= A0;
+  if (pin < HOST_PINS) analog[pin].fn = fn;
+}
+
+unsigned long host_analogReads() {
+  return analog_reads;
+}
+
+int analogRead(uint8_t pin) {
+  AnalogScript *script;
+  unsigned long phase;
+  double value;
+  
+  if (pin >= A0) pin -= A0;
+  clock_us += HOST_ADC_US;
+  analog_reads++;
+  if (pin >= HOST_PINS) return 0;
+  
+  script = &analog[pin];
+  if (script->fn) {
+    value = script->fn(pin, (unsigned long)clock_us);
+  }
+  else {
+    phase = clock_us % (script->period ? script->period : 1);
+    switch (script->shape) {
+      case HOST_RAMP :
+        value = script->level + (double)script->amplitude * phase / script->period;
+        break;
+      case HOST_SINE :
+        value = script->level + script->amplitude * sin(2.0 * M_PI * phase / script->period);
+        break;
+      default :
+        value = script->level;
+        break;
+    }
+  }
+  if (script->noise) {
+    // xorshift, reproducible from run to run
+    noise_state ^= noise_state << 13;
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    value += (int)(noise_state % (2 * script->noise + 1)) - script->noise;
+  }
+  
+  if (value < 0) return 0;
+  if (value > 1023) return 1023;
+  return (int)(value + 0.5);
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Serial
+ * ----------------------------------------------------------------------------------------------*/
+int HardwareSerial::available() {
+  int c = getchar();
+  
+  if (c == EOF) return 0;
+  ungetc(c, stdin);
+  return 1;
+}
+
+int HardwareSerial::read() {
+  int c = getchar();
+  
+  return c == EOF ? -1 : c;
+}
+
+int HardwareSerial::peek() {
+  int c = getchar();
+  
+  if (c == EOF) return -1;
+  ungetc(c, stdin);
+  return c;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  putchar(c);
+  return 1;
+}
@@ -0,0 +1,26 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: HardwareSerial.h
+ * Function: Host-side Arduino core stand-in
+ * Description: Serial, writing to stdout and reading from stdin.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Stream.h"
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long) {}
+    void end() {}
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual size_t write(uint8_t);
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,82 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: Print.cpp
+ * Function: Host-side Arduino core stand-in
+ * Description: Implementation of the Print class, following the Arduino core's formatting.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include "Arduino.h"
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(const char *str) { return write(str); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char b, int base) { return print((unsigned long)b, base); }
+size_t Print::print(int n, int base) { return print((long)n, base); }
+size_t Print::print(unsigned int n, int base) { return print((unsigned long)n, base); }
+
+size_t Print::print(long n, int base) {
+  if (base == DEC && n < 0) return print('-') + printNumber(-n, DEC);
+  return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  return printNumber(n, base);
+}
+
+size_t Print::print(double number, int digits) {
+  size_t n = 0;
+  double rounding = 0.5;
+  unsigned long whole;
+  double remainder;
+  int i;
+  
+  if (isnan(number)) return print("nan");
+  if (isinf(number)) return print("inf");
+  if (number < 0.0) {
+    n += print('-');
+    number = -number;
+  }
+  for (i = 0; i < digits; i++) rounding /= 10.0;
+  number += rounding;
+  
+  whole = (unsigned long)number;
+  remainder = number - (double)whole;
+  n += print(whole);
+  if (digits > 0) n += print('.');
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    n += print((int)remainder);
+    remainder -= (int)remainder;
+  }
+  return n;
+}
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const char *s) { return print(s) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char b, int base) { return print(b, base) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+  
+  if (base < 2) base = 10;
+  *str = '\0';
+  do {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
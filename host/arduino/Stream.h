@@ -0,0 +1,20 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: Stream.h
+ * Function: Host-side Arduino core stand-in
+ * Description: The Arduino Stream interface: a Print that can also be read from.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef Stream_h
+#define Stream_h
+
+#include "Print.h"
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+#endif
@@ -0,0 +1,445 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: Wire.cpp
+ * Function: Host-side Arduino core stand-in
+ * Description: TwoWire on a simulated bus. Every transaction is counted and timed at the
+ *              configured clock; expanders at 0x20-0x27 behave like an MCP23008 whose GPIO
+ *              pins drive an HD44780 wired the Hobbybotics way:
+ *
+ *                7   6   5   4   3   2   1   0
+ *               LT  D7  D6  D5  D4  EN  RS  n/c
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include <vector>
+#include "host.h"
+
+#define EXPANDERS 8
+
+// MCP23008 registers
+enum { IODIR, IPOL, GPINTEN, DEFVAL, INTCON, IOCON, GPPU, INTF, INTCAP, GPIO, OLAT, REGISTERS };
+
+struct Panel {
+  // MCP23008
+  uint8_t reg[REGISTERS];
+  uint8_t pointer;
+  uint8_t inputs;           // levels driven onto input pins
+  uint8_t pins;             // current pin levels
+  
+  // HD44780
+  bool eightBit;
+  bool highNibble;          // next 4 bit transfer is the high half
+  uint8_t pending;
+  bool cgram;
+  uint8_t address;
+  uint8_t ddram[128];
+  uint8_t cg[64];
+  unsigned long long busyUntil;
+  uint8_t resets;           // 8 bit function sets seen since the interface was last unknown
+  unsigned long instructions, data, violations;
+};
+
+TwoWire Wire;
+
+static Panel panels[EXPANDERS];
+static HostWireStats stats;
+static uint32_t bus_clock = 100000;
+static std::vector<HostTransaction> log_entries;
+static bool log_enabled = false;
+static uint8_t fail_address, fail_count, fail_code;
+static uint32_t clock_limit;
+
+static HostTransaction current;   // transaction being built or read back
+static uint8_t rx_pos;
+static unsigned long long byte_time;   // when the byte being applied finished on the wire
+
+/*-----------------------------------------------------------------------------------------------
+ * HD44780
+ * ----------------------------------------------------------------------------------------------*/
+static void lcd_execute(Panel *p, uint8_t value, bool rs) {
+  unsigned long long now = byte_time;
+  
+  if (now < p->busyUntil) p->violations++;
+  p->busyUntil = now + HOST_LCD_EXEC_US;
+  
+  if (rs) {
+    p->data++;
+    if (p->cgram) {
+      p->cg[p->address & 0x3F] = value;
+      p->address = (p->address + 1) & 0x3F;
+    }
+    else {
+      p->ddram[p->address & 0x7F] = value;
+      p->address++;
+      if (p->address == 0x28) p->address = 0x40;
+      else if (p->address == 0x68) p->address = 0x00;
+    }
+    return;
+  }
+  
+  p->instructions++;
+  if (value & 0x80) {
+    p->cgram = false;
+    p->address = value & 0x7F;
+  }
+  else if (value & 0x40) {
+    p->cgram = true;
+    p->address = value & 0x3F;
+  }
+  else if (value & 0x20) {
+    if (p->eightBit && (value & 0x10)) {
+      if (p->resets == 0) p->busyUntil = now + HOST_LCD_RESET1_US;
+      else if (p->resets == 1) p->busyUntil = now + HOST_LCD_RESET2_US;
+      if (p->resets < 2) p->resets++;
+    }
+    p->eightBit = value & 0x10;
+  }
+  else if (value == 0x01) {
+    memset(p->ddram, ' ', sizeof(p->ddram));
+    p->address = 0;
+    p->cgram = false;
+    p->busyUntil = now + HOST_LCD_HOME_US;
+  }
+  else if ((value & 0xFE) == 0x02) {
+    p->address = 0;
+    p->cgram = false;
+    p->busyUntil = now + HOST_LCD_HOME_US;
+  }
+}
+
+// the LCD latches D7-D4 and RS on the falling edge of EN
+static void lcd_pins(Panel *p, uint8_t before, uint8_t after) {
+  uint8_t nibble = (after >> 3) & 0x0F;
+  bool rs = after & 0x02;
+  
+  if (!(before & 0x04) || (after & 0x04)) return;
+  
+  if (p->eightBit) {
+    // only D7-D4 are wired, D3-D0 read as low
+    lcd_execute(p, nibble << 4, rs);
+    p->highNibble = true;
+  }
+  else if (p->highNibble) {
+    p->pending = nibble << 4;
+    p->highNibble = false;
+  }
+  else {
+    p->highNibble = true;
+    lcd_execute(p, p->pending | nibble, rs);
+  }
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * MCP23008
+ * ----------------------------------------------------------------------------------------------*/
+static void expander_update(Panel *p) {
+  uint8_t before = p->pins;
+  uint8_t changed;
+  uint8_t compare;
+  
+  p->pins = (p->reg[OLAT] & ~p->reg[IODIR]) | (p->inputs & p->reg[IODIR]);
+  
+  // interrupt on change, against DEFVAL or the previous level per INTCON
+  compare = (p->reg[INTCON] & p->reg[DEFVAL]) | (~p->reg[INTCON] & before);
+  changed = (p->pins ^ compare) & p->reg[IODIR] & p->reg[GPINTEN];
+  if (changed && !p->reg[INTF]) {
+    p->reg[INTF] = changed;
+    p->reg[INTCAP] = p->pins ^ p->reg[IPOL];
+  }
+  
+  lcd_pins(p, before, p->pins);
+}
+
+static void expander_write(Panel *p, uint8_t reg, uint8_t value) {
+  switch (reg) {
+    case GPIO :
+    case OLAT :
+      p->reg[OLAT] = value;
+      break;
+    case INTF :
+    case INTCAP :
+      break;   // read only
+    default :
+      p->reg[reg] = value;
+      break;
+  }
+  expander_update(p);
+}
+
+static uint8_t expander_read(Panel *p, uint8_t reg) {
+  uint8_t value;
+  
+  switch (reg) {
+    case GPIO :
+      value = p->pins ^ p->reg[IPOL];
+      p->reg[INTF] = 0;   // reading GPIO or INTCAP clears the interrupt
+      break;
+    case INTCAP :
+      value = p->reg[INTCAP];
+      p->reg[INTF] = 0;
+      break;
+    default :
+      value = p->reg[reg];
+      break;
+  }
+  return value;
+}
+
+static void expander_advance(Panel *p) {
+  if (!(p->reg[IOCON] & 0x20)) p->pointer = (p->pointer + 1) % REGISTERS;
+}
+
+static Panel *expander(uint8_t address) {
+  if ((address & 0xF8) != 0x20) return NULL;
+  return &panels[address & 0x07];
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Bus
+ * ----------------------------------------------------------------------------------------------*/
+
+// start, address byte, data bytes with their ACK bits, stop
+static void bus_spend(uint8_t bytes) {
+  unsigned long us = ((unsigned long)(1 + bytes) * 9 + 2) * 1000000UL / bus_clock + HOST_TWI_OVERHEAD_US;
+  
+  stats.transactions++;
+  stats.bytes += 1 + bytes;
+  stats.busMicros += us;
+  host_advance(us);
+}
+
+static uint8_t bus_fault(uint8_t address) {
+  if (clock_limit && bus_clock > clock_limit) {
+    stats.nacks++;
+    return 2;
+  }
+  if (!fail_count || (fail_address != 0xFF && fail_address != address)) return 0;
+  fail_count--;
+  stats.nacks++;
+  return fail_code;
+}
+
+static void bus_log() {
+  if (log_enabled) log_entries.push_back(current);
+}
+
+void TwoWire::begin() {
+}
+
+void TwoWire::setClock(uint32_t hz) {
+  if (hz) bus_clock = hz;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  current.address = address;
+  current.read = false;
+  current.length = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+  if (current.length >= BUFFER_LENGTH) return 0;
+  current.data[current.length++] = value;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity) {
+  size_t n = 0;
+  
+  while (quantity-- && write(*data++)) n++;
+  return n;
+}
+
+uint8_t TwoWire::endTransmission(uint8_t) {
+  Panel *p = expander(current.address);
+  unsigned long long start = host_time();
+  uint8_t i;
+  
+  bus_spend(current.length);
+  current.result = bus_fault(current.address);
+  if (!current.result && !p) {
+    current.result = 2;   // nobody answered the address
+    stats.nacks++;
+  }
+  
+  if (!current.result && current.length) {
+    p->pointer = current.data[0] % REGISTERS;
+    for (i = 1; i < current.length; i++) {
+      // address byte, register byte, then this one
+      byte_time = start + (unsigned long long)(2 + i) * 9 * 1000000 / bus_clock;
+      expander_write(p, p->pointer, current.data[i]);
+      expander_advance(p);
+    }
+  }
+  bus_log();
+  current.length = 0;
+  return current.result;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+  Panel *p = expander(address);
+  uint8_t i;
+  
+  if (quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+  current.address = address;
+  current.read = true;
+  current.length = 0;
+  rx_pos = 0;
+  
+  bus_spend(quantity);
+  current.result = bus_fault(address);
+  if (!current.result && p) {
+    for (i = 0; i < quantity; i++) {
+      current.data[i] = expander_read(p, p->pointer);
+      expander_advance(p);
+    }
+    current.length = quantity;
+  }
+  else if (!current.result) {
+    stats.nacks++;
+    current.result = 2;
+  }
+  bus_log();
+  return current.length;
+}
+
+int TwoWire::available() {
+  return current.read ? current.length - rx_pos : 0;
+}
+
+int TwoWire::read() {
+  return available() ? current.data[rx_pos++] : -1;
+}
+
+int TwoWire::peek() {
+  return available() ? current.data[rx_pos] : -1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * host.h controls
+ * ----------------------------------------------------------------------------------------------*/
+void host_resetWire() {
+  memset(&stats, 0, sizeof(stats));
+  bus_clock = 100000;
+  log_entries.clear();
+  log_enabled = false;
+  fail_count = 0;
+  clock_limit = 0;
+  for (uint8_t i = 0; i < EXPANDERS; i++) host_panelPowerCycle(0x20 | i);
+}
+
+const HostWireStats &host_wireStats() {
+  return stats;
+}
+
+void host_resetWireStats() {
+  memset(&stats, 0, sizeof(stats));
+}
+
+uint32_t host_wireClock() {
+  return bus_clock;
+}
+
+void host_logTransactions(bool enable) {
+  log_enabled = enable;
+  if (!enable) log_entries.clear();
+}
+
+unsigned long host_transactionCount() {
+  return log_entries.size();
+}
+
+const HostTransaction &host_transaction(unsigned long index) {
+  return log_entries.at(index);
+}
+
+void host_failWire(uint8_t address, uint8_t count, uint8_t code) {
+  fail_address = address;
+  fail_count = count;
+  fail_code = code;
+}
+
+void host_wireLimit(uint32_t hz) {
+  clock_limit = hz;
+}
+
+uint8_t host_expanderRegister(uint8_t address, uint8_t reg) {
+  Panel *p = expander(address);
+  
+  return p && reg < REGISTERS ? p->reg[reg] : 0;
+}
+
+void host_setExpanderInputs(uint8_t address, uint8_t levels) {
+  Panel *p = expander(address);
+  
+  if (!p) return;
+  byte_time = host_time();
+  p->inputs = levels;
+  expander_update(p);
+}
+
+bool host_expanderInterrupt(uint8_t address) {
+  Panel *p = expander(address);
+  
+  return p && p->reg[INTF];
+}
+
+void host_panelPowerCycle(uint8_t address) {
+  Panel *p = expander(address);
+  
+  if (!p) return;
+  memset(p, 0, sizeof(Panel));
+  p->reg[IODIR] = 0xFF;   // power on: all inputs
+  host_lcdPowerCycle(address);
+}
+
+void host_lcdPowerCycle(uint8_t address) {
+  Panel *p = expander(address);
+  
+  if (!p) return;
+  p->eightBit = true;
+  p->highNibble = true;
+  p->cgram = false;
+  p->address = 0;
+  memset(p->ddram, ' ', sizeof(p->ddram));
+  memset(p->cg, 0, sizeof(p->cg));
+  p->busyUntil = 0;
+  p->resets = 0;
+  p->instructions = p->data = p->violations = 0;
+}
+
+void host_lcdRow(uint8_t address, uint8_t row, char *text) {
+  static const uint8_t offsets[4] = { 0x00, 0x40, 0x14, 0x54 };
+  Panel *p = expander(address);
+  uint8_t c;
+  
+  text[0] = '\0';
+  if (!p || row > 3) return;
+  for (uint8_t col = 0; col < 20; col++) {
+    c = p->ddram[offsets[row] + col];
+    text[col] = c < 8 ? '0' + c : (char)c;
+  }
+  text[20] = '\0';
+}
+
+const uint8_t *host_lcdCGRAM(uint8_t address) {
+  Panel *p = expander(address);
+  
+  return p ? p->cg : NULL;
+}
+
+unsigned long host_lcdInstructions(uint8_t address) {
+  Panel *p = expander(address);
+  
+  return p ? p->instructions : 0;
+}
+
+unsigned long host_lcdData(uint8_t address) {
+  Panel *p = expander(address);
+  
+  return p ? p->data : 0;
+}
+
+unsigned long host_lcdBusyViolations(uint8_t address) {
+  Panel *p = expander(address);
+  
+  return p ? p->violations : 0;
+}
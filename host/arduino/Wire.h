@@ -0,0 +1,37 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: Wire.h
+ * Function: Host-side Arduino core stand-in
+ * Description: TwoWire with the AVR library's interface and 32 byte buffer. Transactions go to
+ *              simulated MCP23008 expanders at 0x20-0x27 (each driving an HD44780) and are
+ *              counted, see host.h.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BUFFER_LENGTH 32
+
+class TwoWire {
+  public:
+    void begin();
+    void setClock(uint32_t);
+    void beginTransmission(uint8_t);
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    uint8_t endTransmission(void) { return endTransmission(1); }
+    uint8_t endTransmission(uint8_t);
+    uint8_t requestFrom(uint8_t, uint8_t);
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+    size_t write(uint8_t);
+    size_t write(const uint8_t *, size_t);
+    int available(void);
+    int read(void);
+    int peek(void);
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,105 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: host.h
+ * Function: Host-side Arduino core stand-in
+ * Description: Controls for the simulated board: the virtual clock, scripted analog inputs,
+ *              I2C accounting and fault injection, and the simulated MCP23008/HD44780 panels.
+ *
+ *              Time only moves when the code under test spends it: delay() and
+ *              delayMicroseconds() advance the clock by their argument, analogRead() by one
+ *              conversion, every I2C transaction by its modelled bus time, and each call to
+ *              micros() or millis() by 1us so polling loops terminate.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef host_h
+#define host_h
+
+#include "Arduino.h"
+#include "Wire.h"
+
+// time one analogRead() takes: 13 ADC clocks at 125kHz plus call overhead
+#define HOST_ADC_US 112
+
+// fixed software cost per I2C transaction on top of the bits on the wire
+#define HOST_TWI_OVERHEAD_US 10
+
+// HD44780 execution times the simulated panels enforce
+#define HOST_LCD_HOME_US 1520
+#define HOST_LCD_EXEC_US 37
+
+// waits after the first and second function set of the software reset (datasheet fig. 24)
+#define HOST_LCD_RESET1_US 4100
+#define HOST_LCD_RESET2_US 100
+
+/*-----------------------------------------------------------------------------------------------
+ * Clock
+ * ----------------------------------------------------------------------------------------------*/
+void host_reset();                          // clock, analog inputs, bus, panels back to power on
+void host_advance(unsigned long us);
+unsigned long long host_time();             // microseconds, without advancing the clock
+
+/*-----------------------------------------------------------------------------------------------
+ * Analog inputs, per pin (0-15, A0 also accepted)
+ * ----------------------------------------------------------------------------------------------*/
+enum {
+  HOST_CONSTANT,      // level
+  HOST_RAMP,          // level rising by amplitude over each period, then back
+  HOST_SINE           // level +- amplitude over each period
+};
+
+typedef int (*host_waveform)(uint8_t pin, unsigned long us);
+
+void host_setAnalog(uint8_t pin, uint8_t shape, int level, int amplitude = 0,
+                    unsigned long period_ms = 1000, uint8_t noise = 0);
+void host_setAnalogFunction(uint8_t pin, host_waveform fn);
+unsigned long host_analogReads();
+
+/*-----------------------------------------------------------------------------------------------
+ * I2C bus
+ * ----------------------------------------------------------------------------------------------*/
+struct HostWireStats {
+  unsigned long transactions;     // writes and reads
+  unsigned long bytes;            // on the wire, address bytes included
+  unsigned long busMicros;        // modelled bus time
+  unsigned long nacks;            // failed transactions
+};
+
+struct HostTransaction {
+  uint8_t address;
+  bool read;
+  uint8_t length;
+  uint8_t data[BUFFER_LENGTH];
+  uint8_t result;                 // endTransmission() return value
+};
+
+const HostWireStats &host_wireStats();
+void host_resetWireStats();
+uint32_t host_wireClock();
+
+void host_logTransactions(bool enable);     // keep every transaction for host_transaction()
+unsigned long host_transactionCount();
+const HostTransaction &host_transaction(unsigned long index);
+
+// the next count transactions to address (0xFF = any) fail with endTransmission() code
+void host_failWire(uint8_t address, uint8_t count, uint8_t code);
+
+// above hz the bus is too slow to settle (long wires, weak pull-ups): every transaction is
+// NACKed on the address byte. 0 removes the limit.
+void host_wireLimit(uint32_t hz);
+
+/*-----------------------------------------------------------------------------------------------
+ * Simulated MCP23008 + HD44780 panels, one per expander address 0x20-0x27
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t host_expanderRegister(uint8_t address, uint8_t reg);
+void host_setExpanderInputs(uint8_t address, uint8_t levels);  // levels on input pins
+bool host_expanderInterrupt(uint8_t address);                  // INT pin asserted
+
+void host_panelPowerCycle(uint8_t address);                     // expander and LCD
+void host_lcdPowerCycle(uint8_t address);                       // LCD only
+void host_lcdRow(uint8_t address, uint8_t row, char *text);    // 20 columns, CGRAM as '0'-'7'
+const uint8_t *host_lcdCGRAM(uint8_t address);                 // 64 bytes
+unsigned long host_lcdInstructions(uint8_t address);
+unsigned long host_lcdData(uint8_t address);
+unsigned long host_lcdBusyViolations(uint8_t address);         // writes while still executing
+
+#endif
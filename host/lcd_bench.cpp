@@ -0,0 +1,553 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: lcd_bench.cpp
+ * Function: LCD and AD595 workload benchmark
+ * Description: Runs standard display workloads against the simulated MCP23008/HD44780 panel
+ *              and reports the I2C transactions, bytes on the wire, modelled bus time and total
+ *              elapsed time (bus time plus any waiting on the LCD) each one costs at 100kHz.
+ *              Every workload also checks what ended up on the panel, and that the driver
+ *              never wrote to the LCD while it was still executing.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include "host.h"
+#include "LCD.h"
+#include "LCDBus.h"
+#include "LCDT.h"
+#include "AD595.h"
+#include "AD595Widget.h"
+
+#define PANEL MCP23008_ADDRESS
+
+static LCD lcd;
+static AD595 thermocouple;
+static uint8_t frame[LCD_FRAMEBUFFER_SIZE(20, 4)];
+static int failures = 0;
+
+// the degree symbol from LCD_AD595_demo
+static uint8_t degree[8] = {140,146,146,140,128,128,128,128};
+
+/*-----------------------------------------------------------------------------------------------
+ * Reporting
+ * ----------------------------------------------------------------------------------------------*/
+static HostWireStats mark;
+static unsigned long long markTime;
+
+static void start() {
+  mark = host_wireStats();
+  markTime = host_time();
+}
+
+// the sketch's own pacing, which shouldn't count towards a workload's elapsed time
+static void idle(unsigned long ms) {
+  delay(ms);
+  markTime += ms * 1000ULL;
+}
+
+static void report(const char *name) {
+  const HostWireStats &now = host_wireStats();
+  
+  printf("%-36s %8lu %8lu %10lu %10lu\n", name, now.transactions - mark.transactions,
+         now.bytes - mark.bytes, now.busMicros - mark.busMicros,
+         (unsigned long)(host_time() - markTime));
+}
+
+static void expect(uint8_t row, const char *text, uint8_t panel = PANEL) {
+  char shown[21];
+  
+  host_lcdRow(panel, row, shown);
+  if (strncmp(shown, text, strlen(text))) {
+    printf("  FAIL panel 0x%02X row %u shows \"%s\", expected \"%s\"\n", panel, row, shown, text);
+    failures++;
+  }
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Workloads
+ * ----------------------------------------------------------------------------------------------*/
+static const char *screen[4] = {
+  "Zone 1  231.25C  ON ",
+  "Zone 2  229.50C  OFF",
+  "Zone 3  240.00C  ON ",
+  "Setpoint 235C  12:00"
+};
+
+static void redraw(LCD &panel = lcd) {
+  for (uint8_t row = 0; row < 4; row++) {
+    panel.setCursor(0, row);
+    panel.print(screen[row]);
+  }
+}
+
+// one pass of LCD_AD595_demo's loop() as it was before AD595Widget
+static void demo_loop() {
+  AD595Reading reading = thermocouple.read();
+  
+  lcd.setCursor(0, 1);
+  lcd.print(reading.tempC());
+  lcd.write((byte)0);
+  lcd.print("C ");
+  lcd.print(reading.tempF());
+  lcd.write((byte)0);
+  lcd.print('F');
+}
+
+// after a fault, keep redrawing the first character every 10ms until the panel is back
+static void recover() {
+  idle(LCD_PROBE_MS);
+  for (uint8_t pass = 0; pass < 100; pass++) {
+    lcd.setCursor(0, 0);
+    lcd.print(screen[0][0]);
+    lcd.flush();
+    if (lcd.healthy()) break;
+    idle(10);
+  }
+}
+
+int main() {
+  uint8_t glyph[8];
+  
+  host_reset();
+  host_setAnalog(0, HOST_SINE, 480, 3, 10000, 1);   // ~234C with a slow wobble and noise
+  
+  printf("%-36s %8s %8s %10s %10s\n", "workload", "txns", "bytes", "bus us", "elapsed us");
+  
+  start();
+  lcd.begin(20, 4);
+  report("begin()");
+  
+  start();
+  redraw();
+  report("full 20x4 redraw");
+  for (uint8_t row = 0; row < 4; row++) expect(row, screen[row]);
+  
+  start();
+  for (uint8_t i = 0; i < 8; i++) {
+    for (uint8_t j = 0; j < 8; j++) glyph[j] = (i + j) & 0x1F;
+    lcd.createChar(i, glyph);
+  }
+  report("createChar() x 8");
+  
+  start();
+  for (uint8_t i = 0; i < 8; i++) {
+    for (uint8_t j = 0; j < 8; j++) glyph[j] = (i + j) & 0x1F;
+    lcd.createChar(i, glyph);
+  }
+  report("createChar() x 8, already resident");
+  if (host_lcdCGRAM(PANEL)[7 * 8 + 7] != 14) {
+    printf("  FAIL CGRAM contents\n");
+    failures++;
+  }
+  
+  lcd.createChar(0, degree);
+  lcd.clear();
+  thermocouple.init(0);
+  start();
+  for (uint8_t i = 0; i < 10; i++) {
+    demo_loop();
+    idle(1000);
+  }
+  report("AD595 demo loop x 10");
+  
+  lcd.attachFramebuffer(frame);
+  redraw();
+  start();
+  lcd.flush();
+  report("framebuffer: full 20x4 redraw");
+  for (uint8_t row = 0; row < 4; row++) expect(row, screen[row]);
+  
+  start();
+  for (uint8_t i = 0; i < 10; i++) {
+    demo_loop();
+    lcd.flush();
+    idle(1000);
+  }
+  report("framebuffer: AD595 demo loop x 10");
+  
+  // MCU reset with the board still powered: a fresh LCD object finds the panel configured
+  LCD restarted;
+  restarted.setWarmStart(true);
+  host_logTransactions(true);
+  start();
+  restarted.begin(20, 4);
+  report("begin(), warm restart");
+  if (!restarted.warmStarted()) {
+    printf("  FAIL warm restart not detected\n");
+    failures++;
+  }
+  // the backlight stays on through the resync, it must not flash on a watchdog restart
+  for (unsigned long i = 0; i < host_transactionCount(); i++) {
+    const HostTransaction &t = host_transaction(i);
+    if (t.read || t.address != PANEL || t.length < 2 || t.data[0] != MCP23008_GPIO) continue;
+    for (uint8_t j = 1; j < t.length; j++) {
+      if (!(t.data[j] & 0x80)) {
+        printf("  FAIL backlight dropped by write %lu of a warm begin()\n", i);
+        failures++;
+        i = host_transactionCount();
+        break;
+      }
+    }
+  }
+  host_logTransactions(false);
+  expect(0, screen[0]);   // the demo loop has since overwritten row 1
+  expect(2, screen[2]);
+  
+  // two panels cleared and redrawn from frame queues: drained one after the other, then
+  // interleaved by LCDBus so each clear runs while the other panel is being written
+  static LCDFrame queue1[96], queue2[96];
+  LCD second(1);
+  LCDBus bus;
+  
+  lcd.detachFramebuffer();
+  second.begin(20, 4);
+  lcd.attachQueue(queue1, 96);
+  second.attachQueue(queue2, 96);
+  
+  start();
+  lcd.clear();
+  redraw(lcd);
+  while (lcd.poll()) ;
+  second.clear();
+  redraw(second);
+  while (second.poll()) ;
+  report("2 panels: clear + redraw, in turn");
+  
+  bus.add(lcd);
+  bus.add(second);
+  start();
+  lcd.clear();
+  redraw(lcd);
+  second.clear();
+  redraw(second);
+  bus.flush();
+  report("2 panels: clear + redraw, LCDBus");
+  for (uint8_t row = 0; row < 4; row++) {
+    expect(row, screen[row]);
+    expect(row, screen[row], PANEL + 1);
+  }
+  if (bus.frames(0) != 85 || bus.frames(1) != 85) {
+    printf("  FAIL LCDBus sent %lu and %lu frames, expected 85 each\n", bus.frames(0), bus.frames(1));
+    failures++;
+  }
+  
+  // a zero sized queue could never make room for a frame, so it leaves the panel synchronous
+  lcd.detachQueue();
+  lcd.attachQueue(queue1, 0);
+  lcd.setCursor(0, 0);
+  lcd.print(screen[0]);
+  if (lcd.queued() || lcd.queueSpace()) {
+    printf("  FAIL attachQueue(queue, 0) queued %u frames with room for %u\n", lcd.queued(), lcd.queueSpace());
+    failures++;
+  }
+  expect(0, screen[0]);
+  
+  // faster I2C, on a bus that can't settle above 400kHz: negotiation has to back off from 800kHz
+  host_wireLimit(400000);
+  if (lcd.negotiateClock(800000) != 400000) {
+    printf("  FAIL negotiateClock() picked %lu, expected 400000\n", (unsigned long)lcd.busClock());
+    failures++;
+  }
+  start();
+  redraw();
+  report("full 20x4 redraw at 400kHz");
+  for (uint8_t row = 0; row < 4; row++) expect(row, screen[row]);
+  
+  printf("\nclockSweep(), bus limited to 400kHz\n");
+  lcd.clockSweep(Serial);
+  if (lcd.busClock() != 400000) {
+    printf("  FAIL clockSweep() left the clock at %lu\n", (unsigned long)lcd.busClock());
+    failures++;
+  }
+  host_wireLimit(0);
+  
+  // the panel is unplugged: the loop must keep running with frames dropped, then it comes
+  // back unpowered and is initialized and redrawn from the framebuffer
+  lcd.attachFramebuffer(frame);
+  redraw();
+  lcd.flush();
+  if (host_lcdBusyViolations(PANEL)) {
+    printf("  FAIL %lu writes while the LCD was busy\n", host_lcdBusyViolations(PANEL));
+    failures++;
+  }
+  host_failWire(PANEL, 255, 2);
+  start();
+  for (uint8_t i = 0; i < 10; i++) {
+    demo_loop();
+    lcd.flush();
+    idle(1000);
+  }
+  report("panel unplugged: AD595 demo loop x 10");
+  if (lcd.healthy() || !lcd.errors().nackAddress || !lcd.errors().dropped) {
+    printf("  FAIL unplugged panel not detected\n");
+    failures++;
+  }
+  if (lcd.busClock() != 400000) {
+    printf("  FAIL a missing panel moved the shared clock to %lu\n", (unsigned long)lcd.busClock());
+    failures++;
+  }
+  
+  // re-initializing the panel happens a step per call, so the loop keeps its 10ms pace: no
+  // single pass may wait off the bus for longer than a clear display
+  host_failWire(PANEL, 0, 0);
+  host_panelPowerCycle(PANEL);
+  unsigned long stall = 0, passes = 0;
+  start();
+  while (!lcd.healthy() && passes < 100) {
+    unsigned long long before = host_time();
+    unsigned long bus = host_wireStats().busMicros;
+    
+    demo_loop();
+    lcd.flush();
+    passes++;
+    bus = host_wireStats().busMicros - bus;
+    if (host_time() - before - bus > stall) stall = host_time() - before - bus;
+    idle(10);
+  }
+  report("panel replugged: recovery + redraw");
+  printf("  %lu passes, longest wait in one pass %lu us\n", passes, stall);
+  if (stall > LCD_HOME_US) {
+    printf("  FAIL recovery held up a single pass for %lu us\n", stall);
+    failures++;
+  }
+  if (!lcd.healthy() || lcd.errors().recoveries != 1) {
+    printf("  FAIL panel did not recover\n");
+    failures++;
+  }
+  expect(0, screen[0]);
+  expect(2, screen[2]);
+  expect(3, screen[3]);
+  for (uint8_t j = 0; j < 8; j++) glyph[j] = degree[j] & 0x1F;
+  if (memcmp(host_lcdCGRAM(PANEL), glyph, 8)) {
+    printf("  FAIL custom character not restored\n");
+    failures++;
+  }
+  
+  // bus errors step the clock down on the way to degrading, and recovery puts it back
+  host_failWire(PANEL, 4, 4);
+  lcd.setCursor(0, 0);
+  lcd.print('z');
+  lcd.flush();
+  if (lcd.healthy() || lcd.busClock() >= 400000) {
+    printf("  FAIL bus errors left the LCD %s at %lu\n", lcd.healthy() ? "healthy" : "degraded",
+           (unsigned long)lcd.busClock());
+    failures++;
+  }
+  recover();
+  if (!lcd.healthy() || lcd.busClock() != 400000) {
+    printf("  FAIL clock not restored after recovery: %lu\n", (unsigned long)lcd.busClock());
+    failures++;
+  }
+  expect(0, screen[0]);
+  
+  // a refused data byte may leave the LCD between nibbles, so it isn't retried: the panel
+  // degrades at the same clock and is reset and redrawn on recovery
+  unsigned long recoveries = lcd.errors().recoveries;
+  host_failWire(PANEL, 1, 3);
+  lcd.setCursor(0, 0);
+  lcd.print('z');
+  lcd.flush();
+  if (lcd.healthy() || lcd.busClock() != 400000) {
+    printf("  FAIL a data NACK left the LCD %s at %lu\n", lcd.healthy() ? "healthy" : "degraded",
+           (unsigned long)lcd.busClock());
+    failures++;
+  }
+  recover();
+  if (!lcd.healthy() || lcd.errors().recoveries != recoveries + 1) {
+    printf("  FAIL panel did not recover from a data NACK\n");
+    failures++;
+  }
+  expect(0, screen[0]);
+  expect(2, screen[2]);
+  expect(3, screen[3]);
+  
+  // a transfer too long for Wire's buffer fails the same at any clock: dropped, not retried
+  unsigned long dropped = lcd.errors().dropped;
+  host_failWire(PANEL, 1, 1);
+  lcd.setCursor(0, 0);
+  lcd.print('z');
+  lcd.flush();
+  if (!lcd.healthy() || lcd.busClock() != 400000 || lcd.errors().dropped != dropped + 1) {
+    printf("  FAIL an oversized transfer was retried or moved the clock to %lu\n", 
+           (unsigned long)lcd.busClock());
+    failures++;
+  }
+  lcd.setCursor(0, 0);
+  lcd.print(screen[0][0]);
+  lcd.flush();
+  
+  // a custom character changed while the panel is unreachable reaches CGRAM on recovery,
+  // even though the panel kept power and needs no initialization
+  uint8_t box[8] = { 31, 17, 17, 17, 17, 17, 31, 0 };
+  host_failWire(PANEL, 255, 2);
+  lcd.setCursor(0, 0);
+  lcd.print('z');
+  lcd.flush();
+  lcd.createChar(0, box);
+  host_failWire(PANEL, 0, 0);
+  recover();
+  if (!lcd.healthy() || memcmp(host_lcdCGRAM(PANEL), box, 8)) {
+    printf("  FAIL custom character created while degraded not uploaded on recovery\n");
+    failures++;
+  }
+  lcd.createChar(0, degree);
+  
+  // LCD_AD595_demo's readout as two widgets, loop() running every 10ms: one reading every
+  // 250ms goes to both, and they only write the digits that moved by more than the deadband,
+  // here one ADC step
+  AD595Widget tempC(lcd, 0, 1, 7), tempF(lcd, 8, 1, 7);
+  
+  lcd.detachFramebuffer();
+  lcd.clear();
+  tempC.setRefresh(0);
+  tempC.setSuffix('C');
+  tempC.setDeadband(50);
+  tempF.setRefresh(0);
+  tempF.setUnits(TEMPF);
+  tempF.setSuffix('F');
+  tempF.setDeadband(90);
+  start();
+  for (unsigned i = 0; i < 1000; i++) {
+    if (i % 25 == 0) {
+      AD595Reading reading = thermocouple.read();
+      tempC.show(reading);
+      tempF.show(reading);
+    }
+    idle(10);
+  }
+  report("AD595Widget x 2, 10s");
+  {
+    char want[21];
+    AD595Reading reading = thermocouple.read();
+    
+    // the signal wobbles by about 1.5C, so compare loosely
+    host_lcdRow(PANEL, 1, want);
+    if (want[4] != '.' || want[6] != 'C' || want[12] != '.' || want[14] != 'F' ||
+        (long)(atof(want) * 100) - reading.centiC > 250 || reading.centiC - (long)(atof(want) * 100) > 250) {
+      printf("  FAIL widgets show \"%s\" for %ld.%02ldC\n", want, 
+             (long)reading.centiC / 100, (long)reading.centiC % 100);
+      failures++;
+    }
+  }
+  printf("  %lu + %lu redraws from 40 shared readings\n", tempC.redraws(), tempF.redraws());
+
+  // a zero width field still gets one character besides its suffix, and no more
+  {
+    AD595Widget narrow(lcd, 0, 0, 0);
+    char text[AD595_WIDGET_WIDTH + 1];
+
+    memset(text, '!', sizeof(text));
+    narrow.setSuffix('C');
+    narrow.format(2500, text);
+    if (memcmp(text, "#C!", 3)) {
+      printf("  FAIL zero width widget formats as \"%.*s\"\n", (int)sizeof(text), text);
+      failures++;
+    }
+  }
+  
+  // the compile-time specialized driver on a third panel
+  // pull-ups and inverted inputs left behind by a previous sketch are reset by begin()
+  LCDT<20, 4> fixed(2);
+  Wire.beginTransmission(PANEL + 2);
+  Wire.write((uint8_t)MCP23008_IPOL);
+  Wire.write((uint8_t)0xFF);
+  Wire.endTransmission();
+  Wire.beginTransmission(PANEL + 2);
+  Wire.write((uint8_t)MCP23008_GPPU);
+  Wire.write((uint8_t)0xFF);
+  Wire.endTransmission();
+  fixed.begin();
+  if (host_expanderRegister(PANEL + 2, MCP23008_IPOL) || host_expanderRegister(PANEL + 2, MCP23008_GPPU)) {
+    printf("  FAIL LCDT::begin() kept IPOL %02X and GPPU %02X\n", host_expanderRegister(PANEL + 2, MCP23008_IPOL),
+           host_expanderRegister(PANEL + 2, MCP23008_GPPU));
+    failures++;
+  }
+  start();
+  for (uint8_t row = 0; row < 4; row++) {
+    fixed.setCursor(0, row);
+    fixed.print(screen[row]);
+  }
+  report("LCDT<20, 4>: full 20x4 redraw");
+  for (uint8_t row = 0; row < 4; row++) expect(row, screen[row], PANEL + 2);
+  
+  // a row past the bottom lands on the last one, as with LCD
+  fixed.setCursor(0, 4);
+  fixed.print(screen[0]);
+  expect(3, screen[0], PANEL + 2);
+  fixed.setCursor(0, 3);
+  fixed.print(screen[3]);
+  if (fixed.errors() || host_lcdBusyViolations(PANEL + 2)) {
+    printf("  FAIL LCDT: %lu errors, %lu writes while busy\n", fixed.errors(),
+           host_lcdBusyViolations(PANEL + 2));
+    failures++;
+  }
+  
+  // a button to ground on GP0 of a fourth panel, with 5 bounces 1ms apart on each press and
+  // release, polled every ms for 3s with the ISR simulated off the expander's INT level
+  const uint8_t keyPanel = PANEL + 3;
+  LCD keypad(3);
+  unsigned presses = 0, releases = 0;
+  bool intLine = false;
+  
+  host_setExpanderInputs(keyPanel, 0x01);   // released: the pull-up holds GP0 high
+  if (keypad.setButtons(0xFF) != LCD_BUTTON_PINS) {
+    printf("  FAIL setButtons() took LCD pins\n");
+    failures++;
+  }
+  keypad.begin(20, 4);
+  start();
+  for (unsigned ms = 0; ms < 3000; ms++) {
+    if (ms == 1000 || ms == 2000) {
+      for (uint8_t b = 0; b < 5; b++) {
+        host_setExpanderInputs(keyPanel, b & 1);
+        if (!intLine && host_expanderInterrupt(keyPanel)) keypad.buttonInterrupt();
+        intLine = host_expanderInterrupt(keyPanel);
+        keypad.pollButtons();
+        idle(1);
+      }
+      host_setExpanderInputs(keyPanel, ms == 1000 ? 0x00 : 0x01);
+    }
+    if (!intLine && host_expanderInterrupt(keyPanel)) keypad.buttonInterrupt();
+    intLine = host_expanderInterrupt(keyPanel);
+    if (keypad.pollButtons() & 0x01) {
+      if (keypad.buttons() & 0x01) presses++;
+      else releases++;
+    }
+    idle(1);
+  }
+  report("buttons: 1 bouncy press, 3s polling");
+  if (presses != 1 || releases != 1 || keypad.buttons()) {
+    printf("  FAIL %u presses and %u releases, expected one each\n", presses, releases);
+    failures++;
+  }
+  
+  LCD keypadRestarted(3);
+  keypadRestarted.setButtons(LCD_BUTTON_PINS);
+  keypadRestarted.setWarmStart(true);
+  keypadRestarted.begin(20, 4);
+  if (!keypadRestarted.warmStarted()) {
+    printf("  FAIL warm restart with buttons not detected\n");
+    failures++;
+  }
+  
+#if LCD_STATS
+  printf("\nLCD stats, all workloads: ");
+  lcd.printStats(Serial);
+  printf("\nAD595 stats, all workloads: ");
+  thermocouple.printStats(Serial);
+  printf("\n");
+  if (lcd.stats().transactions == 0 || thermocouple.stats().samples == 0) {
+    printf("  FAIL stats not recorded\n");
+    failures++;
+  }
+#endif
+  
+  for (uint8_t panel = PANEL; panel <= PANEL + 1; panel++) {
+    if (host_lcdBusyViolations(panel)) {
+      printf("  FAIL panel 0x%02X: %lu writes while the LCD was busy\n", panel,
+             host_lcdBusyViolations(panel));
+      failures++;
+    }
+  }
+  
+  return failures ? 1 : 0;
+}
@@ -10,11 +10,57 @@
 
 // Add necessary include files
 #include "AD595.h"
- 
+
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+ * Linearization table. The AD595 amplifies the compensated type K EMF, so its output is
+ * Vout = (EMF + 11uV) * 247.3 (datasheet, table I). The table holds that output at every 50C
+ * from 0 to 500C, worked out by the compiler from NIST type K EMFs in microvolts, in tenths of
+ * a millivolt (which is also hundredths of a degree at the nominal 10mV/C). Next to it is each
+ * segment's slope in hundredths of a degree per tenth of a millivolt, 12 fraction bits, so the
+ * read path interpolates with one multiply and no divide.
+ * ----------------------------------------------------------------------------------------------*/
+#define AD595_VOUT(emf) ((((emf) + 11L) * 2473L + 500) / 1000)
+#define AD595_SLOPE(emf1, emf2) \
+  ((5000L * 4096 + (AD595_VOUT(emf2) - AD595_VOUT(emf1)) / 2) / (AD595_VOUT(emf2) - AD595_VOUT(emf1)))
+
+#define AD595_TABLE_STEP 5000   // hundredths of a degree between entries
+
+static const uint16_t ad595_vout[] PROGMEM = {
+  AD595_VOUT(0),     AD595_VOUT(2023),  AD595_VOUT(4096),  AD595_VOUT(6138),
+  AD595_VOUT(8138),  AD595_VOUT(10153), AD595_VOUT(12209), AD595_VOUT(14293),
+  AD595_VOUT(16397), AD595_VOUT(18516), AD595_VOUT(20644)
+};
+
+static const uint16_t ad595_slope[] PROGMEM = {
+  AD595_SLOPE(0, 2023),      AD595_SLOPE(2023, 4096),   AD595_SLOPE(4096, 6138),
+  AD595_SLOPE(6138, 8138),   AD595_SLOPE(8138, 10153),  AD595_SLOPE(10153, 12209),
+  AD595_SLOPE(12209, 14293), AD595_SLOPE(14293, 16397), AD595_SLOPE(16397, 18516),
+  AD595_SLOPE(18516, 20644)
+};
+
+#define AD595_SEGMENTS (sizeof(ad595_slope) / sizeof(ad595_slope[0]))
+
 /*-----------------------------------------------------------------------------------------------
  * Public Methods
  * ----------------------------------------------------------------------------------------------*/
 
+AD595::AD595() {
+  _oversample = 0;
+  _background = false;
+  _linearize = false;
+  _reference = AD595_REF_VCC;
+  _refMv = AD595_VREF_MV;
+  _gain = 1L << AD595_GAIN_SHIFT;
+  _offset = 0;
+  _corrected = false;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
 void AD595::init(uint8_t DO) {
   _DO = DO;
   
@@ -22,8 +68,19 @@ void AD595::init(uint8_t DO) {
   pinMode(_DO, INPUT);
 }
 
+/*-----------------------------------------------------------------------------------------------
+ * Oversample and decimate: summing 4^n readings and shifting right by n adds n bits of
+ * resolution, provided there is at least 1 LSB of noise on the input. Each extra bit costs
+ * 4x the conversions (about 110us each at the default ADC clock), so 2-3 bits is the
+ * practical limit for a 100Hz loop.
+ * ----------------------------------------------------------------------------------------------*/
+void AD595::setOversampling(uint8_t bits) {
+  if (bits > AD595_MAX_OVERSAMPLING) bits = AD595_MAX_OVERSAMPLING;
+  _oversample = bits;
+}
+
 double AD595::measure(uint8_t type) {
-  double value;
+  double value = 0;
   
   switch(type) {
     case TEMPC : value = tempC(); break;
@@ -32,15 +89,375 @@ double AD595::measure(uint8_t type) {
   return value;
 }
 
+/*-----------------------------------------------------------------------------------------------
+ * Takes one sample and returns it in both units with a timestamp. Use this instead of
+ * measure(TEMPC) followed by measure(TEMPF) to halve the ADC time and get matching values.
+ * ----------------------------------------------------------------------------------------------*/
+AD595Reading AD595::read() {
+  AD595Reading reading;
+  
+  if (_background) {
+    snapshot(&reading.raw, &reading.time);
+    AD595_STAT(_stats.samples++);
+  }
+  else {
+    reading.time = millis();
+    reading.raw = sample();
+  }
+  reading.raw = filter(reading.raw);
+  reading.centiC = rawToCentiC(reading.raw);
+  reading.centiF = _corrected ? centiCToF(reading.centiC) : rawToCentiF(reading.raw);
+  return reading;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Fixed point temperatures in hundredths of a degree. These avoid the soft-float double math
+ * of measure() entirely: one 32 bit multiply and a shift per conversion.
+ * ----------------------------------------------------------------------------------------------*/
+int32_t AD595::measureCentiC() {
+  return rawToCentiC(filter(sample()));
+}
+
+int32_t AD595::measureCentiF() {
+  return rawToCentiF(filter(sample()));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Every reading passes through here between sample() and the conversion. A plain AD595 keeps
+ * the sample as it is; AD595Filtered overrides this, so anything holding an AD595& gets the
+ * filtered value.
+ * ----------------------------------------------------------------------------------------------*/
+uint16_t AD595::filter(uint16_t raw) {
+  return raw;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Takes one (possibly oversampled) ADC sample with 10 + _oversample bits of resolution.
+ * ----------------------------------------------------------------------------------------------*/
+uint16_t AD595::sample() {
+  uint32_t sum = 0;
+  uint16_t count = 1 << (2 * _oversample);
+  uint16_t raw;
+  unsigned long time;
+  
+  AD595_STAT(_stats.samples++);
+  if (_background) {
+    snapshot(&raw, &time);
+    return raw;
+  }
+  
+  AD595_STAT(_stats.conversions += count);
+  AD595_STAT(time = micros());
+  
+  // accumulate in an integer and decimate once, the result has 10 + _oversample bits
+  while (count--) sum += analogRead(_DO);
+  
+  AD595_STAT(time = micros() - time);
+  AD595_STAT(_stats.adcMicros += time);
+  AD595_STAT(if (time > _stats.maxAdcMicros) _stats.maxAdcMicros = time);
+  return sum >> _oversample;
+}
+
 /*-----------------------------------------------------------------------------------------------
  * Private Methods
  * ----------------------------------------------------------------------------------------------*/
-double AD595::tempC() {
-  return (5.0 * analogRead(_DO) * 100.0) / 1024.0;
+
+// the plain 10mV/C into 5V scaling is only right with every correction off
+void AD595::corrections() {
+  _corrected = _linearize || _refMv != AD595_VREF_MV || _offset || 
+               _gain != (1L << AD595_GAIN_SHIFT);
 }
 
-double AD595::tempF() {
-  return ((tempC() * 9.0/5.0) + 32);
+/*-----------------------------------------------------------------------------------------------
+ * Instrumentation, see AD595Stats. Only recorded when built with AD595_STATS set to 1;
+ * otherwise the counters read as zero. Background conversions are counted in the interrupt,
+ * so read them with the background stopped for an exact figure.
+ * ----------------------------------------------------------------------------------------------*/
+const AD595Stats &AD595::stats() {
+  return _stats;
+}
+
+void AD595::clearStats() {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Print the counters on one line with no line ending, so the output also fits on an LCD:
+ * samples, conversions, total and longest synchronous ADC time in microseconds.
+ * ----------------------------------------------------------------------------------------------*/
+void AD595::printStats(Print &out) {
+#if AD595_STATS
+  AD595Stats now = _stats;
+  
+  out.print("n=");
+  out.print(now.samples);
+  out.print(" adc=");
+  out.print(now.conversions);
+  out.print(" us=");
+  out.print(now.adcMicros);
+  out.print(" max=");
+  out.print(now.maxAdcMicros);
+#else
+  out.print("AD595_STATS off");
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Convert a sample from sample() to hundredths of a degree. Both units come from the same raw
+ * value, so a caller that needs C and F only pays for one ADC sample.
+ * ----------------------------------------------------------------------------------------------*/
+int32_t AD595::rawToCentiC(uint16_t raw) {
+  uint8_t shift = 10 + _oversample;
+  uint16_t vout;
+  int32_t centi;
+  
+  if (!_corrected) return scaleCentiC(raw, _oversample);
+  
+  // AD595 output in tenths of a millivolt: at 10mV/C that is already hundredths of a degree
+  vout = ((uint32_t)raw * (_refMv * 10UL) + (1UL << (shift - 1))) >> shift;
+  centi = _linearize ? linearizeCentiC(vout) : vout;
+  return ((centi * _gain + (1L << (AD595_GAIN_SHIFT - 1))) >> AD595_GAIN_SHIFT) + _offset;
+}
+
+int32_t AD595::rawToCentiF(uint16_t raw) {
+  if (!_corrected) return scaleCentiF(raw, _oversample);
+  return centiCToF(rawToCentiC(raw));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Temperature for an AD595 output in tenths of a millivolt, interpolated from the datasheet
+ * table. Outputs outside 0-500C extend the end segments.
+ * ----------------------------------------------------------------------------------------------*/
+int32_t AD595::linearizeCentiC(uint16_t vout) {
+  uint8_t i = 0;
+  uint16_t base;
+  
+  while (i < AD595_SEGMENTS - 1 && vout >= pgm_read_word(&ad595_vout[i + 1])) i++;
+  base = pgm_read_word(&ad595_vout[i]);
+  return (int32_t)i * AD595_TABLE_STEP + 
+         ((((int32_t)vout - base) * (int32_t)pgm_read_word(&ad595_slope[i]) + 2048) >> 12);
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Hundredths of a degree C to F: 1.8 as 29491 / 2^14, no divide.
+ * ----------------------------------------------------------------------------------------------*/
+int32_t AD595::centiCToF(int32_t centiC) {
+  return ((centiC * 29491L + 8192) >> 14) + 3200;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Hundredths of a degree to tenths, rounded and clamped to int16_t, for compact storage.
+ * ----------------------------------------------------------------------------------------------*/
+int16_t AD595::centiToDeci(int32_t centi) {
+  centi = (centi + (centi < 0 ? -5 : 5)) / 10;
+  if (centi > 32767) return 32767;
+  if (centi < -32768) return -32768;
+  return centi;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Map readings through the AD595 datasheet output table instead of assuming exactly 10mV/C.
+ * The correction is largest near the top of the range, about 2C at 500C.
+ * ----------------------------------------------------------------------------------------------*/
+void AD595::setLinearization(bool enable) {
+  _linearize = enable;
+  corrections();
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Choose what the ADC measures against:
+ *   AD595_REF_VCC       AVcc, taken to be millivolts (default 5000)
+ *   AD595_REF_BANDGAP   AVcc, measured now against the bandgap; call measureVcc() again from
+ *                       time to time to follow a drifting rail
+ *   AD595_REF_EXTERNAL  an external reference of millivolts on AREF
+ * Don't switch to AD595_REF_EXTERNAL with AREF tied to a different voltage than AVcc while
+ * the pin is driven; set it before the first reading. A running background acquisition
+ * switches over with its next conversion. References above AD595_MAX_REF_MV are clamped.
+ * ----------------------------------------------------------------------------------------------*/
+void AD595::setReference(uint8_t mode, uint16_t millivolts) {
+  _reference = mode;
+  _refMv = millivolts > AD595_MAX_REF_MV ? AD595_MAX_REF_MV : millivolts;
+  if (mode == AD595_REF_EXTERNAL) {
+    analogReference(EXTERNAL);
+  }
+  else {
+    analogReference(DEFAULT);
+    if (mode == AD595_REF_BANDGAP) measureVcc();
+  }
+#if defined(__AVR__)
+  if (_background) ADMUX = (ADMUX & ~(_BV(REFS1) | _BV(REFS0))) | refsBits(mode);
+#endif
+  corrections();
+}
+
+uint16_t AD595::reference() {
+  return _refMv;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * ADMUX reference selection bits for an AD595_REF_ mode. Everything that programs ADMUX
+ * directly goes through here, so it never connects AVcc to a driven AREF pin. 0 off AVR.
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t AD595::refsBits(uint8_t mode) {
+#if defined(__AVR__)
+  return mode == AD595_REF_EXTERNAL ? 0 : _BV(REFS0);
+#else
+  (void)mode;
+  return 0;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Measure AVcc by converting the internal bandgap against it. In AD595_REF_BANDGAP mode the
+ * result becomes the reference. Not possible while the ADC runs in the background, or off AVR;
+ * then the current reference is returned unchanged. With AD595_REF_EXTERNAL it returns 0
+ * without touching the ADC, since selecting AVcc would short it to the voltage on AREF.
+ * ----------------------------------------------------------------------------------------------*/
+uint16_t AD595::measureVcc() {
+  if (_reference == AD595_REF_EXTERNAL) return 0;
+  
+#if defined(__AVR__)
+  uint8_t admux = ADMUX;
+  uint32_t sum = 0;
+  uint32_t mv;
+  uint8_t i;
+  
+  // the ADC belongs to an interrupt: our background acquisition or a scanner
+  if (_background || (ADCSRA & _BV(ADIE))) return _refMv;
+  
+#if defined(MUX5)
+  ADCSRB &= ~_BV(MUX5);
+  ADMUX = refsBits(_reference) | _BV(MUX4) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);   // 1.1V bandgap
+#else
+  ADMUX = refsBits(_reference) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);               // 1.1V bandgap
+#endif
+  delay(2);                            // let the bandgap buffer settle
+  
+  // the first conversion after a mux change is thrown away
+  for (i = 0; i < 5; i++) {
+    ADCSRA |= _BV(ADSC);
+    while (ADCSRA & _BV(ADSC)) ;
+    if (i) sum += ADCW;
+  }
+  ADMUX = admux;
+  
+  if (!sum) return _refMv;
+  mv = (AD595_BANDGAP_MV * 1024UL * 4 + sum / 2) / sum;
+  if (_reference == AD595_REF_BANDGAP) _refMv = mv > AD595_MAX_REF_MV ? AD595_MAX_REF_MV : mv;
+  return mv;
+#else
+  return _refMv;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Two point calibration. Take readings (with calibration cleared) at two known temperatures,
+ * e.g. an ice bath and boiling water, and pass each reading with the true temperature, all in
+ * hundredths of a degree C. Readings are then corrected with the resulting gain and offset.
+ * Returns false, leaving calibration unchanged, if the two readings are equal.
+ * ----------------------------------------------------------------------------------------------*/
+bool AD595::setCalibration(int32_t measured1, int32_t actual1, int32_t measured2, int32_t actual2) {
+  int32_t span = measured2 - measured1;
+  
+  if (!span) return false;
+  _gain = ((actual2 - actual1) * (1L << AD595_GAIN_SHIFT) + span / 2) / span;
+  _offset = actual1 - ((measured1 * _gain + (1L << (AD595_GAIN_SHIFT - 1))) >> AD595_GAIN_SHIFT);
+  corrections();
+  return true;
+}
+
+void AD595::clearCalibration() {
+  _gain = 1L << AD595_GAIN_SHIFT;
+  _offset = 0;
+  corrections();
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Keep the calibration in EEPROM at address (AD595_EEPROM_SIZE bytes): a marker, gain, offset
+ * and a checksum. loadCalibration() leaves calibration unchanged and returns false if there is
+ * nothing valid stored there. AVR only.
+ * ----------------------------------------------------------------------------------------------*/
+#define AD595_EEPROM_MARKER 0xAD
+
+bool AD595::saveCalibration(int address) {
+#if defined(__AVR__)
+  uint8_t block[AD595_EEPROM_SIZE];
+  uint8_t i, sum = 0;
+  
+  block[0] = AD595_EEPROM_MARKER;
+  memcpy(&block[1], &_gain, 4);
+  memcpy(&block[5], &_offset, 4);
+  for (i = 0; i < AD595_EEPROM_SIZE - 1; i++) sum += block[i];
+  block[AD595_EEPROM_SIZE - 1] = ~sum;
+  eeprom_update_block(block, (void *)address, AD595_EEPROM_SIZE);
+  return true;
+#else
+  (void)address;
+  return false;
+#endif
+}
+
+bool AD595::loadCalibration(int address) {
+#if defined(__AVR__)
+  uint8_t block[AD595_EEPROM_SIZE];
+  uint8_t i, sum = 0;
+  
+  eeprom_read_block(block, (const void *)address, AD595_EEPROM_SIZE);
+  for (i = 0; i < AD595_EEPROM_SIZE - 1; i++) sum += block[i];
+  if (block[0] != AD595_EEPROM_MARKER || block[AD595_EEPROM_SIZE - 1] != (uint8_t)~sum) return false;
+  
+  memcpy(&_gain, &block[1], 4);
+  memcpy(&_offset, &block[5], 4);
+  corrections();
+  return true;
+#else
+  (void)address;
+  return false;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * The conversions behind rawToCentiC/F for a sample with 10 + bits bits of resolution.
+ * ----------------------------------------------------------------------------------------------*/
+int32_t AD595::scaleCentiC(uint16_t raw, uint8_t bits) {
+  uint8_t shift = 10 + bits;
+  
+  // 65535 * 50000 still fits in 32 bits, add half an LSB to round
+  return ((uint32_t)raw * AD595_FULLSCALE_CENTIC + (1UL << (shift - 1))) >> shift;
 }
 
+int32_t AD595::scaleCentiF(uint16_t raw, uint8_t bits) {
+  uint8_t shift = 9 + bits;
+  
+  // fold the 9/5 into the scale; halve it so 65535 * scale stays within 32 bits
+  return (((uint32_t)raw * (AD595_FULLSCALE_CENTIF / 2) + (1UL << (shift - 1))) >> shift) + 3200;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Private Methods
+ * ----------------------------------------------------------------------------------------------*/
 
+// Copy the latest background result without disabling interrupts: retry if the interrupt
+// published a new one while we were reading. Waits for the very first result only.
+// Without the interrupt, convert here until the next result is published.
+void AD595::snapshot(uint16_t *raw, unsigned long *time) {
+  uint8_t seq;
+  
+#if !defined(__AVR__)
+  seq = _seq;
+  while (seq == _seq) adcComplete(analogRead(_DO));
+#endif
+  do {
+    seq = _seq;
+    *raw = _snapRaw;
+    *time = _snapTime;
+  } while (!seq || (seq & 1) || seq != _seq);
+}
+
+double AD595::tempC() {
+  return measureCentiC() / 100.0;
+}
+
+double AD595::tempF() {
+  return measureCentiF() / 100.0;
+}
@@ -18,21 +18,206 @@
 #include <WProgram.h>            // Arduino 0023 and below
 #endif
 
+// most extra bits setOversampling() accepts (4^6 = 4096 readings per measurement)
+#define AD595_MAX_OVERSAMPLING 6
+
+// decimated samples averaged by the background acquisition ring
+#define AD595_RING_SIZE 4
+
+// ADC reference and AD595 output scale (10mV per degree C)
+#define AD595_VREF_MV 5000
+#define AD595_MV_PER_DEGREE 10
+
+// highest reference setReference() takes, the AVR's AVcc limit. It keeps the output in tenths
+// of a millivolt within 16 bits, and a 16 bit sample times it within 32.
+#define AD595_MAX_REF_MV 5500
+
+// hundredths of a degree spanned by the full 10 bit ADC range, folded by the compiler
+#define AD595_FULLSCALE_CENTIC ((uint32_t)AD595_VREF_MV * 100 / AD595_MV_PER_DEGREE)
+#define AD595_FULLSCALE_CENTIF (AD595_FULLSCALE_CENTIC * 9 / 5)
+
+// ADC reference modes for setReference()
+enum {
+  AD595_REF_VCC,        // AVcc, taken to be the given voltage
+  AD595_REF_BANDGAP,    // AVcc, measured against the internal 1.1V bandgap
+  AD595_REF_EXTERNAL    // voltage on the AREF pin
+};
+
+// nominal bandgap voltage; the real one is 1.0-1.2V, so measure yours and set it for best results
+#ifndef AD595_BANDGAP_MV
+#define AD595_BANDGAP_MV 1100
+#endif
+
+// calibration gain fraction bits (16384 = 1.0)
+#define AD595_GAIN_SHIFT 14
+
+// EEPROM bytes used by saveCalibration()
+#define AD595_EEPROM_SIZE 10
+
+// Compile-time opt-in instrumentation. Build the library with -DAD595_STATS=1 to record
+// AD595Stats; at 0 none of the counting code is compiled in. Only the counting depends on it,
+// the class layout doesn't, so a sketch that sees a different setting still links safely.
+#ifndef AD595_STATS
+#define AD595_STATS 0
+#endif
+
+#if AD595_STATS
+#define AD595_STAT(x) x
+#else
+#define AD595_STAT(x)
+#endif
+
+// ADC work per sensor, counted since construction or clearStats()
+struct AD595Stats {
+  unsigned long samples;        // samples handed out by sample() and read()
+  unsigned long conversions;    // ADC conversions, including background ones
+  unsigned long adcMicros;      // time spent in analogRead() by synchronous samples
+  unsigned long maxAdcMicros;   // longest synchronous sample
+};
+
 enum {
   TEMPC,
   TEMPF
 };
 
+// one ADC sample and when it was taken; both units come from that same sample
+struct AD595Reading {
+  unsigned long time;   // millis() at the sample
+  uint16_t raw;         // ADC sample, 10 + oversampling bits
+  int32_t centiC;       // hundredths of a degree C
+  int32_t centiF;       // hundredths of a degree F
+  
+  double tempC() const { return centiC / 100.0; }
+  double tempF() const { return centiF / 100.0; }
+};
+
 class AD595 {
   public:
+    AD595();
     void init(uint8_t DO);
+    void setOversampling(uint8_t bits);
+    bool beginBackground();
+    void endBackground();
     double measure(uint8_t type);
+    AD595Reading read();
+    int32_t measureCentiC();
+    int32_t measureCentiF();
+    
+    uint16_t sample();
+    int32_t rawToCentiC(uint16_t raw);
+    int32_t rawToCentiF(uint16_t raw);
+    
+    static int32_t scaleCentiC(uint16_t raw, uint8_t bits);
+    static int32_t scaleCentiF(uint16_t raw, uint8_t bits);
+    static int32_t linearizeCentiC(uint16_t vout);
+    static int32_t centiCToF(int32_t centiC);
+    static uint8_t refsBits(uint8_t mode);
+    static int16_t centiToDeci(int32_t centi);
+    
+    void setLinearization(bool enable);
+    void setReference(uint8_t mode, uint16_t millivolts = AD595_VREF_MV);
+    uint16_t measureVcc();
+    uint16_t reference();
+    bool setCalibration(int32_t measured1, int32_t actual1, int32_t measured2, int32_t actual2);
+    void clearCalibration();
+    bool saveCalibration(int address);
+    bool loadCalibration(int address);
+    
+    void adcComplete(uint16_t value);   // called from the ADC interrupt
+    
+    const AD595Stats &stats();
+    void clearStats();
+    void printStats(Print &out);
+    
+  protected:
+    virtual uint16_t filter(uint16_t raw);
         
   private:
     double tempC();
     double tempF();
+    void snapshot(uint16_t *raw, unsigned long *time);
+    
+    void corrections();
     
     int8_t _DO;
+    uint8_t _oversample;    // extra bits of resolution, 4^_oversample readings per sample
+    
+    // corrections beyond the ideal 10mV/C into a 5V reference
+    bool _corrected;        // any of them in use, so the plain scaling can't be used
+    bool _linearize;        // map through the datasheet output table
+    uint8_t _reference;     // AD595_REF_ mode
+    uint16_t _refMv;        // ADC reference in millivolts
+    int32_t _gain;          // two point calibration, 1 << AD595_GAIN_SHIFT = none
+    int32_t _offset;        // hundredths of a degree C
+    
+    // background acquisition, written by the ADC interrupt
+    bool _background;
+    uint32_t _acc;                      // oversampling accumulator
+    uint16_t _accCount;
+    uint16_t _ring[AD595_RING_SIZE];    // latest decimated samples
+    uint32_t _ringSum;
+    uint8_t _ringPos;
+    
+    // seqlock protected snapshot: odd _seq means the interrupt is mid update
+    volatile uint8_t _seq;
+    volatile uint16_t _snapRaw;
+    volatile unsigned long _snapTime;
+    
+    AD595Stats _stats;                  // only counted with AD595_STATS
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * Scans several AD595 boards round-robin. On AVR the ADC conversion complete interrupt walks
+ * the channels in the background, discarding the first conversion after every mux switch;
+ * elsewhere each poll() converts one channel. Results land in per-channel arrays owned by
+ * AD595Array. Only one scanner can own the ADC, and analogRead() must not be used while it runs.
+ * ----------------------------------------------------------------------------------------------*/
+class AD595Scanner {
+  public:
+    AD595Scanner();
+    bool begin();
+    void end();
+    void poll();
+    void setReference(uint8_t mode, uint16_t millivolts = AD595_VREF_MV);
+    
+    uint8_t channels();
+    unsigned long sweeps();
+    uint16_t raw(uint8_t channel);
+    AD595Reading read(uint8_t channel);
+    
+    void adcComplete(uint16_t value);   // called from the ADC interrupt
+    
+  protected:
+    void attach(const uint8_t *pins, uint8_t count, volatile uint16_t *raw, 
+                volatile unsigned long *time);
+    
+  private:
+    void select(uint8_t channel);
+    
+    const uint8_t *_pins;
+    volatile uint16_t *_raw;            // latest sample per channel
+    volatile unsigned long *_time;      // millis() of that sample
+    uint8_t _count;
+    uint8_t _reference;                 // AD595_REF_VCC or AD595_REF_EXTERNAL
+    uint16_t _refMv;                    // ADC reference in millivolts
+    volatile uint8_t _channel;          // channel being converted
+    volatile bool _discard;             // next conversion follows a mux switch
+    volatile unsigned long _sweeps;     // completed passes over all channels
+};
+
+template <uint8_t CHANNELS>
+class AD595Array : public AD595Scanner {
+  public:
+    void init(const uint8_t *pins) {
+      memcpy(_pinList, pins, CHANNELS);
+      for (uint8_t i = 0; i < CHANNELS; i++) pinMode(_pinList[i], INPUT);
+      attach(_pinList, CHANNELS, _rawList, _timeList);
+    }
+    
+  private:
+    uint8_t _pinList[CHANNELS];
+    volatile uint16_t _rawList[CHANNELS];
+    volatile unsigned long _timeList[CHANNELS];
 };
 
 #endif
\ No newline at end of file
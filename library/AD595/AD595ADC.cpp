@@ -0,0 +1,281 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: AD595ADC.cpp
+ * Function: AD595 Thermocouple library, interrupt driven acquisition
+ * Description: Background acquisition and AD595Scanner, the two users of the ADC conversion
+ *              complete interrupt. They live apart from AD595.cpp so that ADC_vect is only
+ *              linked into sketches that call beginBackground() or use an AD595Array, and
+ *              other libraries that need the vector still link with the rest of AD595.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include "AD595.h"
+
+#if defined(__AVR__)
+#include <avr/interrupt.h>
+#endif
+
+// scanner or background sensor that currently owns the ADC conversion complete interrupt
+static AD595Scanner *adc_owner = NULL;
+static AD595 *adc_background = NULL;
+
+/*-----------------------------------------------------------------------------------------------
+ * Background acquisition: the ADC free-runs on this sensor's pin and the conversion complete
+ * interrupt oversamples, averages the last AD595_RING_SIZE results and publishes them. Every
+ * measurement then just copies the latest value instead of waiting for conversions.
+ * Off AVR there is no conversion complete interrupt, so each measurement converts until the
+ * oversampler publishes a new result, through the same ring.
+ * Only one sensor or scanner can own the ADC, and analogRead() must not be used meanwhile.
+ * Returns false if the ADC already has an owner.
+ * ----------------------------------------------------------------------------------------------*/
+bool AD595::beginBackground() {
+  if (adc_owner || adc_background) return false;
+  
+  _acc = 0;
+  _accCount = 0;
+  _seq = 0;
+  _background = true;
+  adc_background = this;
+  
+#if defined(__AVR__)
+  uint8_t pin = _DO;
+  
+#if ARDUINO >= 100
+  if (pin >= A0) pin -= A0;            // accept both 0 and A0
+#endif
+#if defined(MUX5)
+  ADCSRB = (ADCSRB & ~_BV(MUX5)) | (((pin >> 3) & 0x01) << MUX5);
+#endif
+  ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));   // free running trigger
+  ADMUX = refsBits(_reference) | (pin & 0x07);
+  ADCSRA |= _BV(ADIF);                 // a stale result mustn't fire the interrupt
+  ADCSRA |= _BV(ADATE) | _BV(ADIE) | _BV(ADSC);
+#endif
+  return true;
+}
+
+void AD595::endBackground() {
+  if (!_background) return;
+#if defined(__AVR__)
+  ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+  while (ADCSRA & _BV(ADSC)) ;         // let the last conversion finish
+  ADCSRA |= _BV(ADIF);                 // and drop its result, or the next owner gets it first
+#endif
+  adc_background = NULL;
+  _background = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Feed one background conversion through the oversampler and the averaging ring, then publish
+ * the result. Interrupt context on AVR.
+ * ----------------------------------------------------------------------------------------------*/
+void AD595::adcComplete(uint16_t value) {
+  uint16_t decimated;
+  uint8_t i;
+  
+  AD595_STAT(_stats.conversions++);
+  _acc += value;
+  if (++_accCount < (1 << (2 * _oversample))) return;
+  
+  decimated = _acc >> _oversample;
+  _acc = 0;
+  _accCount = 0;
+  
+  if (!_seq) {
+    // first result, prime the ring with it
+    for (i = 0; i < AD595_RING_SIZE; i++) _ring[i] = decimated;
+    _ringSum = (uint32_t)decimated * AD595_RING_SIZE;
+    _ringPos = 0;
+  }
+  else {
+    _ringSum += decimated - _ring[_ringPos];
+    _ring[_ringPos] = decimated;
+    if (++_ringPos == AD595_RING_SIZE) _ringPos = 0;
+  }
+  
+  _seq++;
+  _snapRaw = _ringSum / AD595_RING_SIZE;
+  _snapTime = millis();
+  if (!++_seq) _seq = 2;               // 0 is reserved for "no result yet"
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * AD595Scanner
+ * ----------------------------------------------------------------------------------------------*/
+AD595Scanner::AD595Scanner() {
+  _pins = NULL;
+  _raw = NULL;
+  _time = NULL;
+  _count = 0;                          // nothing attached, begin() refuses to start
+  _reference = AD595_REF_VCC;
+  _refMv = AD595_VREF_MV;
+  _channel = 0;
+  _sweeps = 0;
+}
+
+void AD595Scanner::attach(const uint8_t *pins, uint8_t count, volatile uint16_t *raw,
+                          volatile unsigned long *time) {
+  _pins = pins;
+  _raw = raw;
+  _time = time;
+  _count = count;
+  _channel = 0;
+  _sweeps = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    raw[i] = 0;
+    time[i] = 0;
+  }
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Start scanning. On AVR this hands the ADC to the conversion complete interrupt and returns;
+ * the sweep then runs entirely in the background. Returns false, and doesn't start, if no
+ * channels are attached or the ADC already belongs to a background sensor or another scanner.
+ * ----------------------------------------------------------------------------------------------*/
+bool AD595Scanner::begin() {
+  if (!_count || adc_background) return false;
+  if (adc_owner && adc_owner != this) return false;
+  _channel = 0;
+  adc_owner = this;
+#if defined(__AVR__)
+  select(0);
+  _discard = true;                     // the mux may have been elsewhere for analogRead()
+  ADCSRA &= ~_BV(ADATE);               // single conversions, started from the interrupt
+  ADCSRA |= _BV(ADIF);                 // a stale result would use up the discard
+  ADCSRA |= _BV(ADIE) | _BV(ADSC);
+#else
+  _discard = false;
+#endif
+  return true;
+}
+
+void AD595Scanner::end() {
+#if defined(__AVR__)
+  ADCSRA &= ~_BV(ADIE);
+  while (ADCSRA & _BV(ADSC)) ;         // let the last conversion finish
+  ADCSRA |= _BV(ADIF);                 // and drop its result, or the next owner gets it first
+#endif
+  adc_owner = NULL;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Without an ADC interrupt, convert the next channel. A no-op on AVR, where the interrupt
+ * does the work.
+ * ----------------------------------------------------------------------------------------------*/
+void AD595Scanner::poll() {
+#if !defined(__AVR__)
+  if (adc_owner == this) adcComplete(analogRead(_pins[_channel]));
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * What every channel is measured against, AD595_REF_VCC or AD595_REF_EXTERNAL, as for
+ * AD595::setReference(). Call before begin().
+ * ----------------------------------------------------------------------------------------------*/
+void AD595Scanner::setReference(uint8_t mode, uint16_t millivolts) {
+  _reference = mode == AD595_REF_EXTERNAL ? AD595_REF_EXTERNAL : AD595_REF_VCC;
+  _refMv = millivolts > AD595_MAX_REF_MV ? AD595_MAX_REF_MV : millivolts;
+  analogReference(_reference == AD595_REF_EXTERNAL ? EXTERNAL : DEFAULT);
+}
+
+uint8_t AD595Scanner::channels() {
+  return _count;
+}
+
+unsigned long AD595Scanner::sweeps() {
+  unsigned long sweeps;
+  
+  noInterrupts();
+  sweeps = _sweeps;
+  interrupts();
+  return sweeps;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Latest sample of a channel. A channel beyond channels() reads as 0, with time 0 in read(),
+ * the same as a channel that hasn't been converted yet.
+ * ----------------------------------------------------------------------------------------------*/
+uint16_t AD595Scanner::raw(uint8_t channel) {
+  uint16_t value;
+  
+  if (channel >= _count) return 0;
+  noInterrupts();
+  value = _raw[channel];
+  interrupts();
+  return value;
+}
+
+AD595Reading AD595Scanner::read(uint8_t channel) {
+  AD595Reading reading;
+  
+  if (channel >= _count) {
+    memset(&reading, 0, sizeof(reading));
+    return reading;
+  }
+  noInterrupts();
+  reading.raw = _raw[channel];
+  reading.time = _time[channel];
+  interrupts();
+  if (_refMv == AD595_VREF_MV) {
+    reading.centiC = AD595::scaleCentiC(reading.raw, 0);
+    reading.centiF = AD595::scaleCentiF(reading.raw, 0);
+  }
+  else {
+    // tenths of a millivolt, i.e. hundredths of a degree at 10mV/C
+    reading.centiC = ((uint32_t)reading.raw * (_refMv * 10UL) + 512) >> 10;
+    reading.centiF = AD595::centiCToF(reading.centiC);
+  }
+  return reading;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Store a finished conversion and move on to the next channel.
+ * ----------------------------------------------------------------------------------------------*/
+void AD595Scanner::adcComplete(uint16_t value) {
+  if (_discard) {
+    // the sample-and-hold was still settling from the previous channel
+    _discard = false;
+  }
+  else {
+    _raw[_channel] = value;
+    _time[_channel] = millis();
+    if (++_channel == _count) {
+      _channel = 0;
+      _sweeps++;
+    }
+    if (_count > 1) {
+      select(_channel);
+#if defined(__AVR__)
+      _discard = true;
+#endif
+    }
+  }
+#if defined(__AVR__)
+  ADCSRA |= _BV(ADSC);
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Point the ADC mux at a channel's pin, against the reference from setReference().
+ * ----------------------------------------------------------------------------------------------*/
+void AD595Scanner::select(uint8_t channel) {
+#if defined(__AVR__)
+  uint8_t pin = _pins[channel];
+  
+#if ARDUINO >= 100
+  if (pin >= A0) pin -= A0;            // accept both 0 and A0
+#endif
+#if defined(MUX5)
+  ADCSRB = (ADCSRB & ~_BV(MUX5)) | (((pin >> 3) & 0x01) << MUX5);
+#endif
+  ADMUX = AD595::refsBits(_reference) | (pin & 0x07);
+#else
+  (void)channel;
+#endif
+}
+
+#if defined(__AVR__)
+ISR(ADC_vect) {
+  if (adc_owner) adc_owner->adcComplete(ADC);
+  else if (adc_background) adc_background->adcComplete(ADC);
+}
+#endif
@@ -0,0 +1,144 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: AD595Filter.h
+ * Function: AD595 Thermocouple library, reading filters
+ * Description: Allocation free integer filters for AD595 samples, picked at compile time.
+ *              Each filter works on raw ADC samples and exposes uint16_t update(uint16_t).
+ *
+ *                AD595EMA<SHIFT>            exponential moving average, alpha = 1/2^SHIFT
+ *                AD595MovingAverage<N>      mean of the last N samples, O(1) running sum
+ *                AD595Median<N>             median of the last 3 or 5 samples, rejects spikes
+ *                AD595Chain<A, B>           A followed by B
+ *
+ *              AD595Filtered<FILTER> is an AD595 whose readings pass through FILTER:
+ *
+ *                AD595Filtered< AD595Chain< AD595Median<3>, AD595EMA<3> > > thermocouple;
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef AD595Filter_h
+#define AD595Filter_h
+
+#include "AD595.h"
+
+/*-----------------------------------------------------------------------------------------------
+ * Exponential moving average. The state keeps SHIFT fraction bits so small steps aren't lost.
+ * ----------------------------------------------------------------------------------------------*/
+template <uint8_t SHIFT>
+class AD595EMA {
+  public:
+    AD595EMA() : _state(0), _primed(false) {}
+    
+    uint16_t update(uint16_t sample) {
+      if (!_primed) {
+        _state = (int32_t)sample << SHIFT;
+        _primed = true;
+      }
+      _state += (int32_t)sample - (_state >> SHIFT);
+      return (_state + (1L << SHIFT >> 1)) >> SHIFT;
+    }
+    
+  private:
+    int32_t _state;
+    bool _primed;
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * Moving average over a fixed window; the running sum makes each update O(1).
+ * ----------------------------------------------------------------------------------------------*/
+template <uint8_t N>
+class AD595MovingAverage {
+  public:
+    AD595MovingAverage() : _sum(0), _pos(0), _primed(false) {}
+    
+    uint16_t update(uint16_t sample) {
+      if (!_primed) {
+        for (uint8_t i = 0; i < N; i++) _window[i] = sample;
+        _sum = (uint32_t)sample * N;
+        _pos = 0;
+        _primed = true;
+      }
+      _sum += sample;
+      _sum -= _window[_pos];
+      _window[_pos] = sample;
+      if (++_pos == N) _pos = 0;
+      return (_sum + N / 2) / N;
+    }
+    
+  private:
+    uint16_t _window[N];
+    uint32_t _sum;
+    uint8_t _pos;
+    bool _primed;
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * Median of the last 3 or 5 samples. A single spike never reaches the output.
+ * ----------------------------------------------------------------------------------------------*/
+template <uint8_t N>
+class AD595Median {
+  // only 3 and 5 sample windows are supported
+  typedef char window_must_be_3_or_5[(N == 3 || N == 5) ? 1 : -1];
+  
+  public:
+    AD595Median() : _pos(0), _primed(false) {}
+    
+    uint16_t update(uint16_t sample) {
+      uint16_t sorted[N];
+      uint16_t value;
+      uint8_t i, j;
+      
+      if (!_primed) {
+        for (i = 0; i < N; i++) _window[i] = sample;
+        _pos = 0;
+        _primed = true;
+      }
+      _window[_pos] = sample;
+      if (++_pos == N) _pos = 0;
+      
+      // insertion sort, at most 10 compares for 5 samples
+      for (i = 0; i < N; i++) {
+        value = _window[i];
+        for (j = i; j > 0 && sorted[j - 1] > value; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = value;
+      }
+      return sorted[N / 2];
+    }
+    
+  private:
+    uint16_t _window[N];
+    uint8_t _pos;
+    bool _primed;
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * Two filters in series, e.g. a median to drop spikes followed by an EMA to smooth.
+ * ----------------------------------------------------------------------------------------------*/
+template <class A, class B>
+class AD595Chain {
+  public:
+    uint16_t update(uint16_t sample) {
+      return _second.update(_first.update(sample));
+    }
+    
+  private:
+    A _first;
+    B _second;
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * An AD595 with a filter attached. Every read()/measure() takes one sample and runs it through
+ * the filter, so call it at a steady rate. The filter sits behind AD595::filter(), so it also
+ * applies when the sensor is used through an AD595&, e.g. AD595Widget::bind().
+ * ----------------------------------------------------------------------------------------------*/
+template <class FILTER>
+class AD595Filtered : public AD595 {
+  protected:
+    uint16_t filter(uint16_t raw) {
+      return _filter.update(raw);
+    }
+    
+  private:
+    FILTER _filter;
+};
+
+#endif
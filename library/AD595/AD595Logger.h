@@ -0,0 +1,309 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: AD595Logger.h
+ * Function: AD595 Thermocouple library, rolling statistics
+ * Description: Fixed memory logger giving the minimum, maximum and mean temperature over the
+ *              last second, minute and ten minutes, without rescanning any history.
+ *
+ *                AD595Logger<> log;                 // 60 slots per tier, about 1KB
+ *                AD595Logger<20> log;               // 20 slots per tier, about 330 bytes
+ *                ...
+ *                log.add(thermocouple.read());      // as often as you like
+ *                AD595Summary last = log.summary(AD595_LOG_10MIN);
+ *
+ *              Readings are kept in tenths of a degree C. Each completed second is folded
+ *              into a slot of the minute tier, which holds SLOTS slots of 60/SLOTS seconds;
+ *              every ten of those become one slot of the ten minute tier. A tier keeps each
+ *              slot's mean, minimum and maximum in packed int16_t rings and tracks its window
+ *              minimum and maximum with monotonic queues, so adding and querying are O(1).
+ *              Tiers cover whole slots, so the minute tier lags by up to one slot.
+ *
+ *              Means are per slot, i.e. time weighted: a burst of readings doesn't outweigh
+ *              a quiet stretch. Seconds without readings leave empty slots that count for
+ *              nothing; after more than ten minutes without readings the logger starts over.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef AD595Logger_h
+#define AD595Logger_h
+
+#include "AD595.h"
+
+// tiers for summary() and history()
+enum {
+  AD595_LOG_1S,
+  AD595_LOG_1MIN,
+  AD595_LOG_10MIN
+};
+
+// a tier's statistics, in tenths of a degree C
+struct AD595Summary {
+  int16_t min;
+  int16_t max;
+  int16_t mean;
+  uint16_t count;   // readings (1 second tier) or slots with readings behind them, 0 = no data
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * Readings folded together: one tumbling period of the logger.
+ * ----------------------------------------------------------------------------------------------*/
+class AD595Period {
+  public:
+    AD595Period() { clear(); }
+    
+    void clear() {
+      _min = 32767;
+      _max = -32768;
+      _sum = 0;
+      _count = 0;
+    }
+    
+    void add(int16_t deciC) {
+      if (deciC < _min) _min = deciC;
+      if (deciC > _max) _max = deciC;
+      _sum += deciC;
+      _count++;
+    }
+    
+    // one slot of the next tier down counts once, whatever it was made of
+    void add(const AD595Summary &slot) {
+      if (!slot.count) return;
+      if (slot.min < _min) _min = slot.min;
+      if (slot.max > _max) _max = slot.max;
+      _sum += slot.mean;
+      _count++;
+    }
+    
+    AD595Summary summary() const {
+      AD595Summary s;
+      
+      s.min = _min;
+      s.max = _max;
+      s.mean = _count ? (_sum + (_sum < 0 ? -(int32_t)_count : (int32_t)_count) / 2) / (int32_t)_count : 0;
+      s.count = _count;
+      return s;
+    }
+  
+  private:
+    int16_t _min, _max;
+    int32_t _sum;
+    uint16_t _count;
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * Sliding window over the last N slots. The queues hold ring positions whose minimum (or
+ * maximum) could still become the window's once the slots before them expire, in order, so
+ * the front is always the answer and each slot enters and leaves each queue once.
+ * ----------------------------------------------------------------------------------------------*/
+template <uint8_t N>
+class AD595Window {
+  public:
+    AD595Window() { clear(); }
+    
+    void clear() {
+      _next = _filled = _slots = 0;
+      _sum = 0;
+      _minHead = _minCount = _maxHead = _maxCount = 0;
+    }
+    
+    void push(const AD595Summary &slot) {
+      uint8_t pos = _next;
+      
+      // the oldest slot drops out
+      if (_filled == N) {
+        if (_min[pos] <= _max[pos]) {
+          _sum -= _mean[pos];
+          _slots--;
+        }
+        if (_minCount && _minQ[_minHead] == pos) pop(_minHead, _minCount);
+        if (_maxCount && _maxQ[_maxHead] == pos) pop(_maxHead, _maxCount);
+      }
+      else {
+        _filled++;
+      }
+      
+      if (slot.count) {
+        _mean[pos] = slot.mean;
+        _min[pos] = slot.min;
+        _max[pos] = slot.max;
+        _sum += slot.mean;
+        _slots++;
+        
+        // anything no lower (higher) than the new slot can never be the minimum (maximum) again
+        while (_minCount && _min[_minQ[back(_minHead, _minCount)]] >= slot.min) _minCount--;
+        _minQ[back(_minHead, ++_minCount)] = pos;
+        while (_maxCount && _max[_maxQ[back(_maxHead, _maxCount)]] <= slot.max) _maxCount--;
+        _maxQ[back(_maxHead, ++_maxCount)] = pos;
+      }
+      else {
+        _min[pos] = 32767;             // empty: min above max
+        _max[pos] = -32768;
+      }
+      
+      _next = pos + 1 < N ? pos + 1 : 0;
+    }
+    
+    AD595Summary summary() const {
+      AD595Summary s;
+      
+      s.count = _slots;
+      if (!_slots) {
+        s.min = s.max = s.mean = 0;
+        return s;
+      }
+      s.min = _min[_minQ[_minHead]];
+      s.max = _max[_maxQ[_maxHead]];
+      s.mean = (_sum + (_sum < 0 ? -(int32_t)_slots : (int32_t)_slots) / 2) / (int32_t)_slots;
+      return s;
+    }
+    
+    // mean of the slot age slots back (0 = newest), false if it is empty or not filled yet
+    bool history(uint8_t age, int16_t *deciC) const {
+      uint8_t pos;
+      
+      if (age >= _filled) return false;
+      pos = _next > age ? _next - 1 - age : _next + N - 1 - age;
+      if (_min[pos] > _max[pos]) return false;
+      *deciC = _mean[pos];
+      return true;
+    }
+  
+  private:
+    static uint8_t back(uint8_t head, uint8_t count) {
+      return head + count - 1 < N ? head + count - 1 : head + count - 1 - N;
+    }
+    
+    static void pop(uint8_t &head, uint8_t &count) {
+      head = head + 1 < N ? head + 1 : 0;
+      count--;
+    }
+    
+    int16_t _mean[N], _min[N], _max[N];   // per slot, tenths of a degree C
+    int32_t _sum;                         // of the means of slots with data
+    uint8_t _next;                        // ring position the next slot goes in
+    uint8_t _filled;                      // slots pushed, up to N
+    uint8_t _slots;                       // of those, slots with data
+    uint8_t _minQ[N], _minHead, _minCount;
+    uint8_t _maxQ[N], _maxHead, _maxCount;
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * The logger. SLOTS must divide 60.
+ * ----------------------------------------------------------------------------------------------*/
+template <uint8_t SLOTS = 60>
+class AD595Logger {
+  public:
+    enum {
+      SLOT_SECONDS = 60 / SLOTS,        // seconds per minute tier slot
+      TEN_SLOTS = 10                    // minute tier slots per ten minute tier slot
+    };
+    
+    AD595Logger() { clear(); }
+    
+    void clear() {
+      _started = false;
+      _second.clear();
+      _minuteSlot.clear();
+      _tenSlot.clear();
+      _minute.clear();
+      _ten.clear();
+      _lastSecond = AD595Period().summary();
+      _seconds = _minutes = 0;
+    }
+    
+    void add(const AD595Reading &reading) {
+      add(AD595::centiToDeci(reading.centiC), reading.time);
+    }
+    
+    // a reading in tenths of a degree C, taken at millis() time
+    void add(int16_t deciC, unsigned long time) {
+      if (!_started || time - _secondStart > 600000UL + 1000) {
+        if (_started) clear();
+        _started = true;
+        _secondStart = time;
+      }
+      while (time - _secondStart >= 1000) {
+        closeSecond();
+        _secondStart += 1000;
+      }
+      _second.add(deciC);
+    }
+    
+    AD595Summary summary(uint8_t tier) const {
+      switch (tier) {
+        case AD595_LOG_1S : return _lastSecond;
+        case AD595_LOG_1MIN : return _minute.summary();
+        default : return _ten.summary();
+      }
+    }
+    
+    // mean of a minute or ten minute tier slot, age slots back (0 = newest)
+    bool history(uint8_t tier, uint8_t age, int16_t *deciC) const {
+      if (tier == AD595_LOG_1MIN) return _minute.history(age, deciC);
+      if (tier == AD595_LOG_10MIN) return _ten.history(age, deciC);
+      return false;
+    }
+    
+    // one line, min/mean/max per tier in degrees C, e.g. "1s 21.3/21.4/21.6 1m ... 10m -"
+    void printSummary(Print &out) const {
+      static const char *const names[3] = { "1s ", " 1m ", " 10m " };
+      AD595Summary s;
+      
+      for (uint8_t tier = AD595_LOG_1S; tier <= AD595_LOG_10MIN; tier++) {
+        s = summary(tier);
+        out.print(names[tier]);
+        if (!s.count) {
+          out.print('-');
+          continue;
+        }
+        printDeci(out, s.min);
+        out.print('/');
+        printDeci(out, s.mean);
+        out.print('/');
+        printDeci(out, s.max);
+      }
+    }
+  
+  private:
+    // SLOTS must divide 60; this fails to compile otherwise
+    typedef char slots_divide_60[60 % SLOTS ? -1 : 1];
+    
+    void closeSecond() {
+      _lastSecond = _second.summary();
+      _second.clear();
+      _minuteSlot.add(_lastSecond);
+      if (++_seconds < SLOT_SECONDS) return;
+      
+      _seconds = 0;
+      _minute.push(_minuteSlot.summary());
+      _tenSlot.add(_minuteSlot.summary());
+      _minuteSlot.clear();
+      if (++_minutes < TEN_SLOTS) return;
+      
+      _minutes = 0;
+      _ten.push(_tenSlot.summary());
+      _tenSlot.clear();
+    }
+    
+    static void printDeci(Print &out, int16_t deciC) {
+      int32_t value = deciC;
+      
+      if (value < 0) {
+        out.print('-');
+        value = -value;
+      }
+      out.print(value / 10);
+      out.print('.');
+      out.print(value % 10);
+    }
+    
+    bool _started;
+    unsigned long _secondStart;         // millis() the current second began
+    AD595Period _second;                // readings so far this second
+    AD595Summary _lastSecond;           // the last completed second
+    AD595Period _minuteSlot, _tenSlot;  // slots being built
+    uint8_t _seconds, _minutes;         // lower tier slots folded into them so far
+    AD595Window<SLOTS> _minute;
+    AD595Window<SLOTS> _ten;
+};
+
+#endif
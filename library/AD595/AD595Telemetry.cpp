@@ -0,0 +1,115 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: AD595Telemetry.cpp
+ * Function: AD595 Thermocouple library, binary telemetry
+ * Description: Delta encoded, CRC checked, COBS framed readings, see AD595Telemetry.h.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include "AD595Telemetry.h"
+
+AD595Telemetry::AD595Telemetry(Print &out) {
+  _out = &out;
+  _length = 0;
+  _frames = 0;
+  _records = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Queue a reading, in tenths of a degree C. The frame goes out once it can't take another
+ * record; call flush() to send a partial one sooner. Returns false for a channel beyond
+ * AD595_TELEMETRY_CHANNELS.
+ * ----------------------------------------------------------------------------------------------*/
+bool AD595Telemetry::add(uint8_t channel, const AD595Reading &reading) {
+  return add(channel, AD595::centiToDeci(reading.centiC), reading.time);
+}
+
+bool AD595Telemetry::add(uint8_t channel, int16_t deciC, unsigned long time) {
+  int32_t delta;
+  
+  if (channel >= AD595_TELEMETRY_CHANNELS) return false;
+  
+  if (!_length) {
+    _frame[0] = AD595_TELEMETRY_VERSION;
+    _frame[1] = time;
+    _frame[2] = time >> 8;
+    _frame[3] = time >> 16;
+    _frame[4] = time >> 24;
+    _length = 5;
+    _time = time;
+    memset(_last, 0, sizeof(_last));
+  }
+  
+  delta = (int32_t)deciC - _last[channel];
+  _frame[_length++] = channel;
+  varint(time - _time);
+  varint(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));   // zigzag: small either way
+  _last[channel] = deciC;
+  _time = time;
+  _records++;
+  
+  if (_length + AD595_TELEMETRY_RECORD_MAX + 2 > AD595_TELEMETRY_FRAME) flush();
+  return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Close the open frame, if any: append the CRC and write it COBS encoded with its 0 delimiter.
+ * ----------------------------------------------------------------------------------------------*/
+void AD595Telemetry::flush() {
+  uint16_t crc;
+  uint8_t start = 0;
+  uint8_t i;
+  
+  if (!_length) return;
+  
+  crc = crc16(_frame, _length);
+  _frame[_length++] = crc;
+  _frame[_length++] = crc >> 8;
+  
+  // COBS: each run of non-zero bytes is sent after a byte giving its length + 1, standing in
+  // for the zero that ended it
+  for (i = 0; i <= _length; i++) {
+    if (i < _length && _frame[i]) continue;
+    _out->write((uint8_t)(i - start + 1));
+    _out->write(&_frame[start], i - start);
+    start = i + 1;
+  }
+  _out->write((uint8_t)0);
+  
+  _length = 0;
+  _frames++;
+}
+
+unsigned long AD595Telemetry::frames() {
+  return _frames;
+}
+
+unsigned long AD595Telemetry::records() {
+  return _records;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * CRC-16/CCITT (polynomial 0x1021, MSB first), bitwise to keep the table out of flash. Pass
+ * the previous result as crc to continue over several blocks.
+ * ----------------------------------------------------------------------------------------------*/
+uint16_t AD595Telemetry::crc16(const uint8_t *data, uint8_t length, uint16_t crc) {
+  uint8_t bit;
+  
+  while (length--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (bit = 0; bit < 8; bit++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Private Methods
+ * ----------------------------------------------------------------------------------------------*/
+
+// LEB128: 7 bits per byte, low first, top bit set on all but the last
+void AD595Telemetry::varint(uint32_t value) {
+  while (value >= 0x80) {
+    _frame[_length++] = value | 0x80;
+    value >>= 7;
+  }
+  _frame[_length++] = value;
+}
@@ -0,0 +1,79 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: AD595Telemetry.h
+ * Function: AD595 Thermocouple library, binary telemetry
+ * Description: Streams readings to any Print (Serial, a file, ...) as small binary frames
+ *              instead of formatted text, so several thermocouples can be logged at hundreds
+ *              of samples a second over one serial link. host/ad595_decode turns the stream
+ *              back into CSV.
+ *
+ *                AD595Telemetry telemetry(Serial);
+ *                ...
+ *                telemetry.add(0, oven.read(0));
+ *                telemetry.add(1, oven.read(1));
+ *
+ *              A frame, before framing:
+ *
+ *                version        AD595_TELEMETRY_VERSION
+ *                time           millis() of the first record, 4 bytes little endian
+ *                records        channel, then varint ms since the previous record, then
+ *                               zigzag varint change in tenths of a degree C since the
+ *                               channel's previous record in this frame (from 0 for its first)
+ *                crc            CRC-16/CCITT of everything above, 2 bytes little endian
+ *
+ *              Each frame is COBS encoded and ends in a 0 byte, so a reader that joins the
+ *              stream anywhere resynchronizes at the next 0. Frames stand alone: the delta
+ *              state restarts in each one, and a lost frame costs only its own records.
+ *              A steady temperature costs 3 bytes per record.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef AD595Telemetry_h
+#define AD595Telemetry_h
+
+#include "AD595.h"
+
+#define AD595_TELEMETRY_VERSION 1
+
+// frame buffer before COBS encoding, CRC included; 16 to 254 bytes. The upper limit keeps the
+// frame within one COBS block and its length within a uint8_t, the lower one fits the header,
+// one record and the CRC. Bigger frames cost less header per record, smaller ones reach the
+// reader sooner.
+#ifndef AD595_TELEMETRY_FRAME
+#define AD595_TELEMETRY_FRAME 64
+#endif
+
+// channels with their own delta state
+#define AD595_TELEMETRY_CHANNELS 8
+
+// longest record: channel, 5 byte time varint, 3 byte value varint
+#define AD595_TELEMETRY_RECORD_MAX 9
+
+class AD595Telemetry {
+  // AD595_TELEMETRY_FRAME must be 16 to 254, see above
+  typedef char frame_must_be_16_to_254[(AD595_TELEMETRY_FRAME >= 5 + AD595_TELEMETRY_RECORD_MAX + 2 &&
+                                        AD595_TELEMETRY_FRAME <= 254) ? 1 : -1];
+  
+  public:
+    AD595Telemetry(Print &out);
+    
+    bool add(uint8_t channel, const AD595Reading &reading);
+    bool add(uint8_t channel, int16_t deciC, unsigned long time);
+    void flush();
+    
+    unsigned long frames();
+    unsigned long records();
+    
+    static uint16_t crc16(const uint8_t *data, uint8_t length, uint16_t crc = 0xFFFF);
+    
+  private:
+    void varint(uint32_t value);
+    
+    Print *_out;
+    uint8_t _frame[AD595_TELEMETRY_FRAME];
+    uint8_t _length;                              // 0 when no frame is open
+    unsigned long _time;                          // millis() of the last record
+    int16_t _last[AD595_TELEMETRY_CHANNELS];      // last value per channel in this frame
+    unsigned long _frames, _records;
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: AD595Widget.h
+ * Function: AD595 Thermocouple library, LCD temperature field
+ * Description: Shows one thermocouple in a fixed width field of an LCD from the I2C LCD
+ *              library, and only talks to the LCD when the text in that field changes.
+ *
+ *                AD595Widget zone1(lcd, 8, 0, 6);    // 6 characters at column 8, row 0
+ *                zone1.bind(thermocouple);
+ *                zone1.setSuffix('C');
+ *                ...
+ *                zone1.poll();                       // from loop(), as often as you like
+ *
+ *              poll() reads the sensor at most once per refresh period (250ms by default).
+ *              Readings within the deadband of the value on screen (one displayed digit by
+ *              default) are ignored, so noise in the last digit doesn't flicker it. The value
+ *              is formatted with integer arithmetic, right aligned, and only the characters
+ *              that differ from the screen are written. Values that don't fit show as '#'.
+ *
+ *              Include <LCD.h> and <Wire.h> in the sketch as well. With a framebuffer
+ *              attached to the LCD the writes land there and go out on the next flush().
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef AD595Widget_h
+#define AD595Widget_h
+
+#include "AD595.h"
+#include <LCD.h>
+
+// widest field
+#define AD595_WIDGET_WIDTH 8
+
+// default minimum time between readings, in ms
+#define AD595_WIDGET_REFRESH_MS 250
+
+class AD595Widget {
+  public:
+    AD595Widget(LCD &lcd, uint8_t col, uint8_t row, uint8_t width) {
+      _lcd = &lcd;
+      _col = col;
+      _row = row;
+      _width = width;
+      _sensor = NULL;
+      _scanner = NULL;
+      _channel = 0;
+      _units = TEMPC;
+      _decimals = 1;
+      _suffix = 0;
+      _hasSuffix = false;
+      _deadband = 10;
+      _refresh = AD595_WIDGET_REFRESH_MS;
+      _redraws = 0;
+      clampWidth();
+      invalidate();
+    }
+    
+    // where poll() reads from
+    void bind(AD595 &sensor) {
+      _sensor = &sensor;
+      _scanner = NULL;
+    }
+    
+    void bind(AD595Scanner &scanner, uint8_t channel) {
+      _scanner = &scanner;
+      _sensor = NULL;
+      _channel = channel;
+    }
+    
+    // TEMPC or TEMPF
+    void setUnits(uint8_t units) {
+      _units = units;
+      invalidate();
+    }
+    
+    // 0 or 1 digits after the point; the deadband follows unless set afterwards
+    void setDecimals(uint8_t decimals) {
+      _decimals = decimals ? 1 : 0;
+      _deadband = _decimals ? 10 : 100;
+      invalidate();
+    }
+    
+    // character drawn after the number, e.g. 'C' or a custom degree glyph
+    void setSuffix(uint8_t suffix) {
+      _suffix = suffix;
+      _hasSuffix = true;
+      clampWidth();
+      invalidate();
+    }
+    
+    void noSuffix() {
+      _hasSuffix = false;
+      invalidate();
+    }
+    
+    // hundredths of a degree a reading must move from the value on screen to be shown
+    void setDeadband(uint16_t centi) {
+      _deadband = centi;
+    }
+    
+    // minimum ms between readings, i.e. the highest refresh rate
+    void setRefresh(uint16_t ms) {
+      _refresh = ms;
+    }
+    
+    // forget what is on screen, e.g. after lcd.clear(); the next reading redraws the field
+    void invalidate() {
+      _drawn = false;
+      _dueAt = millis();
+    }
+    
+    // read the bound sensor if the refresh period is up; true if the LCD was written
+    bool poll() {
+      if (!due()) return false;
+      if (_sensor) return draw(_sensor->read());
+      if (_scanner) return draw(_scanner->read(_channel));
+      return false;
+    }
+    
+    // show a reading taken elsewhere, subject to the same refresh period and deadband
+    bool show(const AD595Reading &reading) {
+      if (!due()) return false;
+      return draw(reading);
+    }
+    
+    unsigned long redraws() { return _redraws; }
+    
+    // the field for a value in hundredths of a degree, width characters, no terminator
+    void format(int32_t centi, char *text) {
+      uint8_t room = _hasSuffix ? _width - 1 : _width;
+      
+      memset(text, ' ', room);
+      if (!digits(centi, text, room)) memset(text, '#', room);
+      if (_hasSuffix) text[room] = _suffix;
+    }
+  
+  private:
+    // at most AD595_WIDGET_WIDTH, and room for at least one character besides the suffix
+    void clampWidth() {
+      uint8_t least = _hasSuffix ? 2 : 1;
+      
+      if (_width > AD595_WIDGET_WIDTH) _width = AD595_WIDGET_WIDTH;
+      if (_width < least) _width = least;
+    }
+    
+    // right aligned in text[0..pos), false if it doesn't fit
+    bool digits(int32_t centi, char *text, uint8_t pos) {
+      bool negative = centi < 0;
+      uint32_t value = negative ? -centi : centi;
+      uint8_t count = 0;
+      uint16_t v;
+      
+      value = _decimals ? (value + 5) / 10 : (value + 50) / 100;
+      if (value > 0xFFFF) return false;
+      if (!value) negative = false;
+      
+      // 16 bit division from here, cheaper on AVR
+      v = value;
+      do {
+        if (!pos) return false;
+        text[--pos] = '0' + v % 10;
+        v /= 10;
+        if (++count == _decimals) {
+          if (!pos) return false;
+          text[--pos] = '.';
+        }
+      } while (v || count <= _decimals);
+      if (negative) {
+        if (!pos) return false;
+        text[--pos] = '-';
+      }
+      return true;
+    }
+    
+    bool due() {
+      unsigned long now = millis();
+      
+      if ((long)(now - _dueAt) < 0) return false;
+      _dueAt = now + _refresh;
+      return true;
+    }
+    
+    bool draw(const AD595Reading &reading) {
+      int32_t centi = _units == TEMPF ? reading.centiF : reading.centiC;
+      int32_t moved = centi - _shown;
+      char text[AD595_WIDGET_WIDTH];
+      uint8_t first, last;
+      
+      if (_drawn && moved < (int32_t)_deadband && -moved < (int32_t)_deadband) return false;
+      
+      format(centi, text);
+      _shown = centi;
+      
+      // just the span that differs, all of it after invalidate()
+      first = 0;
+      last = _width - 1;
+      if (_drawn) {
+        while (first < _width && text[first] == _text[first]) first++;
+        if (first == _width) return false;
+        while (text[last] == _text[last]) last--;
+      }
+      
+      _lcd->setCursor(_col + first, _row);
+      _lcd->write((const uint8_t *)&text[first], last - first + 1);
+      memcpy(_text, text, _width);
+      _drawn = true;
+      _redraws++;
+      return true;
+    }
+    
+    LCD *_lcd;
+    uint8_t _col, _row, _width;
+    AD595 *_sensor;                     // bound sensor, or
+    AD595Scanner *_scanner;             // bound scanner and
+    uint8_t _channel;                   // its channel
+    uint8_t _units;                     // TEMPC or TEMPF
+    uint8_t _decimals;
+    uint8_t _suffix;
+    bool _hasSuffix;
+    uint16_t _deadband;                 // hundredths of a degree
+    uint16_t _refresh;                  // ms
+    unsigned long _dueAt;               // millis() of the next reading
+    bool _drawn;                        // _shown and _text match the screen
+    int32_t _shown;                     // value behind the text on screen
+    char _text[AD595_WIDGET_WIDTH];     // text on screen
+    unsigned long _redraws;
+};
+
+#endif
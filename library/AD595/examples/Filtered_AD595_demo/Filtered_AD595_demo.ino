@@ -0,0 +1,31 @@
+/*
+ Demonstration sketch for Hobbybotics AD595 Thermocouple breakout board.
+ 
+ Reads temperature through a median-of-3 spike filter followed by an exponential moving
+ average, and prints the raw and filtered readings to the serial monitor ten times a second.
+*/
+
+#include <AD595.h>
+#include <AD595Filter.h>
+
+AD595 raw;
+AD595Filtered< AD595Chain< AD595Median<3>, AD595EMA<3> > > filtered;
+  
+void setup() {
+  Serial.begin(9600);
+  raw.init(0);
+  filtered.init(0);
+  
+  Serial.println("AD595 filter test");
+  // wait for AD595 chip to stabilize
+  delay(500);
+}
+
+void loop() {
+  Serial.print("raw C = "); 
+  Serial.print(float(raw.read().tempC()));
+  Serial.print("  filtered C = ");
+  Serial.println(float(filtered.read().tempC()));
+ 
+  delay(100);
+}
@@ -2,9 +2,14 @@
  Demonstration sketch for Hobbybotics AD595 Thermocouple breakout board.
  
  Reads temperature from AD595 in celsius and fahrenheit.  Prints results to I2C LCD.
+ 
+ The sensor is read once every 250ms and that one reading goes to both AD595Widgets, so
+ C and F always come from the same sample. Each widget ignores changes smaller than one ADC
+ step, formats without floating point and only sends the characters that actually changed.
 */
 
 #include <AD595.h>
+#include <AD595Widget.h>
 #include <LCD.h>
 #include <Wire.h>
 
@@ -13,12 +18,16 @@ AD595 thermocouple;
 // Default I2C address for LCD is 0
 LCD lcd(1);
 
+// 7 characters each on row 1, e.g. " 234.9C  455.6F"
+AD595Widget tempC(lcd, 0, 1, 7);
+AD595Widget tempF(lcd, 8, 1, 7);
+
 // make a degree symbol
 uint8_t degree[8]  = {140,146,146,140,128,128,128,128};
 
 void setup() {
   lcd.begin(20, 4);
-  lcd.createChar(0, degree);
+  lcd.createChar(1, degree);
   
   thermocouple.init(0);
 
@@ -28,23 +37,24 @@ void setup() {
   lcd.clear();
   lcd.setCursor(0, 0);
   lcd.print("AD595 test");
+  
+  tempC.setRefresh(0);          // loop() paces the readings
+  tempC.setDeadband(50);        // one 10 bit ADC step is 0.49C
+  tempC.setSuffix(1);           // the degree symbol
+  tempF.setRefresh(0);
+  tempF.setUnits(TEMPF);
+  tempF.setDeadband(90);
+  tempF.setSuffix(1);
 }
 
 void loop() {
-  float temp_c;
-  float temp_f;
+  static unsigned long next = 0;
+  AD595Reading reading;
   
-  // Read values from the sensor
-  temp_c = thermocouple.measure(TEMPC);
-  temp_f = thermocouple.measure(TEMPF);
-   
-  lcd.setCursor(0,1);
-  lcd.print(temp_c);
-  lcd.write((byte)0);
-  lcd.print("C ");
-  lcd.print(temp_f);
-  lcd.write((byte)0);
-  lcd.print('F');
+  if ((long)(millis() - next) < 0) return;
+  next = millis() + 250;
   
-  delay(1000);
+  reading = thermocouple.read();
+  tempC.show(reading);
+  tempF.show(reading);
 }
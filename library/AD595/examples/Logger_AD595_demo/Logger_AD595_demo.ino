@@ -0,0 +1,38 @@
+/*
+ Demonstration sketch for the Hobbybotics AD595 Thermocouple breakout board.
+ 
+ Reads the AD595 ten times a second into a logger and prints the minimum, mean and
+ maximum temperature over the last second, minute and ten minutes once a second:
+ 
+   1s 21.3/21.4/21.6 1m 21.1/21.4/21.8 10m 20.9/21.3/21.8
+*/
+
+#include <AD595.h>
+#include <AD595Logger.h>
+
+AD595 thermocouple;
+AD595Logger<20> history;      // 20 slots per tier keeps it to about 330 bytes of RAM
+
+unsigned long lastPrint;
+  
+void setup() {
+  Serial.begin(9600);
+  thermocouple.init(0);
+  thermocouple.setOversampling(2);
+  
+  Serial.println("AD595 logger test");
+  // wait for AD595 chip to stabilize
+  delay(500);
+}
+
+void loop() {
+  history.add(thermocouple.read());
+  
+  if (millis() - lastPrint >= 1000) {
+    lastPrint = millis();
+    history.printSummary(Serial);
+    Serial.println();
+  }
+  
+  delay(100);
+}
@@ -0,0 +1,38 @@
+/*
+ Demonstration sketch for several Hobbybotics AD595 Thermocouple breakout boards.
+ 
+ Scans four AD595 boards on analog pins 0-3 in the background and prints every channel
+ to the serial monitor once a second. loop() never waits on the ADC.
+*/
+
+#include <AD595.h>
+
+const uint8_t pins[4] = {0, 1, 2, 3};
+
+AD595Array<4> oven;
+  
+void setup() {
+  Serial.begin(9600);
+  oven.init(pins);
+  
+  Serial.println("AD595 scanner test");
+  // wait for AD595 chips to stabilize
+  delay(500);
+  oven.begin();
+}
+
+void loop() {
+  AD595Reading reading;
+  
+  for (uint8_t i = 0; i < oven.channels(); i++) {
+    reading = oven.read(i);
+    Serial.print("T");
+    Serial.print(i);
+    Serial.print(" = ");
+    Serial.print(float(reading.tempC()));
+    Serial.print("C  ");
+  }
+  Serial.println();
+  
+  delay(1000);
+}
@@ -11,6 +11,10 @@ AD595 thermocouple;
 void setup() {
   Serial.begin(9600);
   thermocouple.init(0);
+  thermocouple.setOversampling(2);  // 16 readings per measurement, 12 bit result
+  thermocouple.setReference(AD595_REF_BANDGAP);  // measure the 5V rail instead of trusting it
+  thermocouple.setLinearization(true);           // follow the datasheet table, not 10mV/C
+  thermocouple.loadCalibration(0);               // two point calibration, if one was saved
   
   Serial.println("AD595 test");
   // wait for AD595 chip to stabilize
@@ -20,10 +24,12 @@ void setup() {
 void loop() {
   // basic readout test, just print the current temp
   
+   AD595Reading reading = thermocouple.read();  // one sample for both units
+   
    Serial.print("C = "); 
-   Serial.println(float(thermocouple.measure(TEMPC)));
+   Serial.println(float(reading.tempC()));
    Serial.print("F = ");
-   Serial.println(float(thermocouple.measure(TEMPF)));
+   Serial.println(float(reading.tempF()));
  
    delay(1000);
 }
\ No newline at end of file
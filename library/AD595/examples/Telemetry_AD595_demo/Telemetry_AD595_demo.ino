@@ -0,0 +1,38 @@
+/*
+ Demonstration sketch for logging several Hobbybotics AD595 Thermocouple breakout boards fast.
+ 
+ Scans four AD595 boards on analog pins 0-3 in the background and streams every channel
+ 100 times a second as compact binary frames instead of text, about 4 bytes per reading.
+ On the PC, decode the serial port to CSV with host/ad595_decode:
+ 
+   stty -F /dev/ttyACM0 115200 raw && ./build/ad595_decode /dev/ttyACM0 > log.csv
+*/
+
+#include <AD595.h>
+#include <AD595Telemetry.h>
+
+const uint8_t pins[4] = {0, 1, 2, 3};
+
+AD595Array<4> oven;
+AD595Telemetry telemetry(Serial);
+
+unsigned long next;
+  
+void setup() {
+  Serial.begin(115200);
+  oven.init(pins);
+  
+  // wait for AD595 chips to stabilize
+  delay(500);
+  oven.begin();
+  next = millis();
+}
+
+void loop() {
+  if ((long)(millis() - next) < 0) return;
+  next += 10;
+  
+  for (uint8_t i = 0; i < oven.channels(); i++) {
+    telemetry.add(i, oven.read(i));
+  }
+}
@@ -22,6 +22,47 @@
 #include <string.h>
 #include <inttypes.h>
 #include <Wire.h>
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#endif
+
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 32
+#endif
+
+// characters that fit in one Wire transaction after the register address
+#define LCD_BURST_CHARS ((BUFFER_LENGTH - 1) / 4)
+
+// DDRAM address of the first column of each row
+static const uint8_t lcd_row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+
+// I2C clocks tried by negotiateClock() and clockSweep(), slowest first
+static const uint32_t lcd_clocks[] = { 100000, 200000, 400000, 800000 };
+#define LCD_CLOCKS (sizeof(lcd_clocks) / sizeof(lcd_clocks[0]))
+
+// Big digit font for printBig(): 8 custom characters that tile into 3x3 digits
+static const uint8_t lcd_bigGlyphs[8][8] PROGMEM = {
+  { B00000, B00111, B01111, B11111, B11111, B11111, B11111, B11111 },
+  { B11100, B11110, B11111, B11111, B11111, B11111, B11111, B11111 },
+  { B11111, B11111, B11111, B11111, B11111, B00000, B00000, B00000 },
+  { B00000, B00000, B00000, B11111, B11111, B11111, B11111, B11111 },
+  { B11111, B11111, B11111, B11111, B11111, B11111, B01111, B00111 },
+  { B11111, B11111, B11111, B11111, B11111, B11111, B00000, B00000 },
+  { B00000, B11111, B11111, B11111, B11111, B11111, B00000, B00000 },
+  { B00000, B11100, B11110, B11111, B11111, B11111, B11111, B11111 }
+};
+
+// Layout of each digit, row by row. 0-7 are the glyphs above, 0xFF a filled box, 0x20 a blank.
+#define BX 0xFF
+#define SP 0x20
+static const uint8_t lcd_bigDigits[3][30] PROGMEM = {
+  //0         1          2         3         4          5         6         7         8         9
+  { BX,2,1,   2,1,SP,    2,2,1,    2,2,1,    0,SP,BX,   BX,2,2,   BX,2,2,   2,2,BX,   BX,2,1,   BX,2,1 },
+  { BX,SP,BX, SP,BX,SP,  0,6,5,    SP,2,1,   5,6,BX,    2,2,1,    BX,6,7,   SP,0,5,   BX,6,BX,  5,6,BX },
+  { 4,3,BX,   3,BX,3,    BX,3,3,   4,3,BX,   SP,SP,BX,  4,3,BX,   4,3,BX,   SP,BX,SP, 4,3,BX,   SP,SP,BX }
+};
+#undef BX
+#undef SP
 
 /*-------------------------------------------------------------------------------------------------
  * Function: LCD
@@ -53,19 +94,52 @@
  * is required by any setup.
  * ----------------------------------------------------------------------------------------------*/ 
 LCD::LCD(){
-  lcd_i2cAddr = 0;
-    
-	// transfer this function call's number into our internal class state
-  // in case they forget to call begin() at least we have something
-  _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
+  lcd_init(0);
 }
 
 LCD::LCD(uint8_t i2cAddr){
+  lcd_init(i2cAddr);
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_init
+ * Description: Shared body of the constructors. Every member that needs a value before begin()
+ *              is set here, so there is one place to add new ones.
+ * Ins: I2C address offset of the expander (0-7)
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_init(uint8_t i2cAddr) {
   lcd_i2cAddr = i2cAddr;
+  _fb = NULL;
+  _queue = NULL;
+  _qSize = _qHead = _qCount = _qHighWater = 0;
+  _ddramAddr = 0xFF;
+  _readyAt = 0;
+  _homeUs = LCD_HOME_US;
+  _execUs = LCD_EXEC_US;
+  _warmStart = false;
+  _warm = false;
+  _clock = _clockSet = LCD_DEFAULT_CLOCK;
+  _retries = LCD_RETRIES;
+  _timeoutUs = LCD_TIMEOUT_US;
+  _degraded = false;
+  _resync = false;
+  _initStep = 0;
+  _numcols = 0;               // not begun
+  _buttonMask = 0;
+  _buttons = 0;
+  _buttonIrq = false;
+  _buttonPending = false;
+  memset(&_errors, 0, sizeof(_errors));
+  memset(&_stats, 0, sizeof(_stats));
+  _glyphValid = 0;
+  _glyphTick = 0;
     
 	// transfer this function call's number into our internal class state
   // in case they forget to call begin() at least we have something
   _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
+  _displaycontrol = LCD_DISPLAYON | LCD_BACKLIGHT;
+  _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -75,104 +149,71 @@ LCD::LCD(uint8_t i2cAddr){
  * Outs: none
  * ----------------------------------------------------------------------------------------------*/
 void LCD::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
-	// SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!
-	// according to datasheet, we need at least 40ms after power rises above 2.7V
-	// before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50
-	delay(50);
-
-	Wire.begin();
-	// first thing we do is get the GPIO expander's head working straight, 
-  // with a boatload of junk data.
-	Wire.beginTransmission(MCP23008_ADDRESS | lcd_i2cAddr);
-#if ARDUINO >= 100
-	Wire.write((byte)MCP23008_IODIR);
-	Wire.write((byte)0xFF);
-	Wire.write((byte)0x00);
-	Wire.write((byte)0x00);
-	Wire.write((byte)0x00);
-	Wire.write((byte)0x00);
-	Wire.write((byte)0x00);
-	Wire.write((byte)0x00);
-	Wire.write((byte)0x00);
-	Wire.write((byte)0x00);
-	Wire.write((byte)0x00);
-#else
-	Wire.send(MCP23008_IODIR);
-	Wire.send(0xFF);
-	Wire.send(0x00);
-	Wire.send(0x00);
-	Wire.send(0x00);
-	Wire.send(0x00);
-	Wire.send(0x00);
-	Wire.send(0x00);
-	Wire.send(0x00);
-	Wire.send(0x00);
-	Wire.send(0x00);
-#endif
-	Wire.endTransmission();
-
-	// now we set the GPIO expander's I/O direction to output since it's soldered to an LCD output.
-	Wire.beginTransmission(MCP23008_ADDRESS | lcd_i2cAddr);
-#if ARDUINO >= 100
-	Wire.write((byte)MCP23008_IODIR);
-	Wire.write((byte)0x00); // all output: 00000000 for pins 1...8
-#else
-	Wire.send(MCP23008_IODIR);
-	Wire.send(0x00); // all output: 00000000 for pins 1...8
-#endif
-	Wire.endTransmission();
-
 	if (lines > 1) {
 		_displayfunction |= LCD_2LINE;
 	}
 	_numlines = lines;
+	_numcols = cols;
+	_glyphValid = 0;  // whatever is in CGRAM, we didn't put it there
+	_ddramAddr = 0xFF;
 	_currline = 0;
+	_degraded = false;
+	_resync = false;
+	_initStep = 0;
 
 	// for some 1 line displays you can select a 10 pixel high font
 	if ((dotsize != 0) && (lines == 1)) {
 		_displayfunction |= LCD_5x10DOTS;
 	}
 
-	//put the LCD into 4 bit mode
-	// start with a non-standard command to make it realize we're speaking 4-bit here
-	// per LCD datasheet, first command is a single 4-bit burst, 0011.
-        //-----
-        //  we cannot assume that the LCD panel is powered at the same time as
-        //  the arduino, so we have to perform a software reset as per page 45
-        //  of the HD44780 datasheet - (kch)
-        //-----
-        // bit pattern for the burstBits function is
-        //
-        //  7   6   5   4   3   2   1   0
-        // LT  D7  D6  D5  D4  EN  RS  n/c
-        //-----
-        lcd_burstBits(B10011100); // send LITE D4 D5 high with enable
-        lcd_burstBits(B10011000); // send LITE D4 D5 high with !enable
-        lcd_burstBits(B10011100); //
-        lcd_burstBits(B10011000); //
-        lcd_burstBits(B10011100); // repeat twice more
-        lcd_burstBits(B10011000); //
-        lcd_burstBits(B10010100); // send D4 low and LITE D5 high with enable
-        lcd_burstBits(B10010000); // send D4 low and LITE D5 high with !enable
-	delay(5); // this shouldn't be necessary, but sometimes 16MHz is stupid-fast.
-	
-	command(LCD_FUNCTIONSET | _displayfunction); // then send 0010NF00 (N=lines, F=font)
-	delay(5); // for safe keeping...
-	command(LCD_FUNCTIONSET | _displayfunction); // ... twice.
-	delay(5); // done!
+	// if the expander still has our configuration the board kept power across an MCU reset
+	// and the LCD is already initialized, so skip the power-on delays
+	if (_warmStart) {
+		lcd_busBegin();
+		_warm = lcd_configured();
+	}
+	else {
+		_warm = false;
+	}
 
-	// turn on the LCD with our defaults. since these libs seem to use personal preference, 
-  // I like a cursor.
-	_displaycontrol = LCD_DISPLAYON;  
-	display();
-	// clear it off
-	clear();
+	if (_warm) {
+		// every frame carries the backlight bit, so set it before the first one: the backlight
+		// is already on and must not flicker across the restart
+		_displaycontrol = LCD_DISPLAYON | LCD_BACKLIGHT;
+		_displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+
+		// the reset may have cut a 4 bit transfer in half. 0011 either completes it (worst case
+		// as a clear or home) or starts an 8 bit function set; the next two put the LCD in
+		// 8 bit mode whichever it was, then 0010 returns it to 4 bit mode.
+		lcd_resetNibble(B10011000, _homeUs);
+		lcd_resetNibble(B10011000, _execUs);
+		lcd_resetNibble(B10011000, _execUs);
+		lcd_resetNibble(B10010000, _execUs);
+
+		command(LCD_FUNCTIONSET | _displayfunction);
+		display();
+		command(LCD_ENTRYMODESET | _displaymode);
+		if (_buttonMask) lcd_buttonConfig();
+		return;
+	}
 
+	// SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!
+	// according to datasheet, we need at least 40ms after power rises above 2.7V
+	// before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50.
+	// The sequence itself is lcd_initStep(), which also re-initializes a panel that lost power
+	// without blocking; here each of its waits is simply sat out.
+	lcd_busBegin();
+
+	// turn on the LCD with our defaults. since these libs seem to use personal preference, 
+  // I like a cursor. The backlight comes on too, if so equipped.
+	_displaycontrol = LCD_DISPLAYON | LCD_BACKLIGHT;
 	_displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
-	// set the entry mode
-	command(LCD_ENTRYMODESET | _displaymode);
 
-	setBacklight(HIGH); // turn the backlight on if so equipped.
+	lcd_initStart();
+	while (_initStep) {
+		while ((long)(micros() - _probeAt) < 0) ;
+		lcd_initStep();
+	}
 }
 
 /********** high level commands, for the user! */
@@ -185,8 +226,13 @@ void LCD::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
  * ----------------------------------------------------------------------------------------------*/
 void LCD::clear()
 {
+	if (_fb) {
+		memset(_fb, ' ', _numcols * _numlines);  // blank the shadow, flush() does the rest
+		_fbCol = _fbRow = 0;
+		return;
+	}
 	command(LCD_CLEARDISPLAY);  // clear display, set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
+	                            // this command takes a long time, lcd_send() makes the next frame wait
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -197,8 +243,12 @@ void LCD::clear()
  * ----------------------------------------------------------------------------------------------*/
 void LCD::home()
 {
+	if (_fb) {
+		_fbCol = _fbRow = 0;
+		return;
+	}
 	command(LCD_RETURNHOME);  // set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
+	                          // this command takes a long time, lcd_send() makes the next frame wait
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -209,9 +259,172 @@ void LCD::home()
  * ----------------------------------------------------------------------------------------------*/
 void LCD::setCursor(uint8_t col, uint8_t row)
 {
-	int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-	if ( row > _numlines ) row = _numlines - 1;    // we count rows starting w/0
-	command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+	if ( row >= _numlines ) row = _numlines - 1;    // we count rows starting w/0
+	if (_fb) {
+		_fbCol = col;
+		_fbRow = row;
+		return;
+	}
+	command(LCD_SETDDRAMADDR | (col + lcd_row_offsets[row]));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: attachFramebuffer
+ * Description: Route all writes into a shadow copy of the screen. Nothing is sent to the LCD
+ *              until flush() is called, and then only the cells that changed. Call after
+ *              begin(). The buffer must hold LCD_FRAMEBUFFER_SIZE(cols, rows) bytes.
+ *              The framebuffer assumes the default left-to-right, no autoscroll entry mode.
+ * Ins: pointer to framebuffer storage
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::attachFramebuffer(uint8_t *buf) {
+	_fb = NULL;
+	clear();  // start from a known blank screen
+
+	memset(buf, ' ', LCD_FRAMEBUFFER_SIZE(_numcols, _numlines));
+	_fb = buf;
+	_fbCol = _fbRow = 0;
+	_ddramAddr = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: detachFramebuffer
+ * Description: Go back to writing straight to the LCD. Pending changes are flushed first.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::detachFramebuffer() {
+	flush();
+	_fb = NULL;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: flush
+ * Description: Send every cell of the shadow screen that differs from what the LCD shows.
+ *              The cursor is only repositioned when the next changed cell isn't the one the
+ *              LCD's address counter already points to.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::flush() {
+	uint8_t *shadow = _fb;
+	uint8_t *committed;
+	uint8_t row, col, run, addr;
+
+	if (!_fb) return;
+	// nothing would get through; the changes stay pending until the panel is back
+	if (_degraded && !lcd_probe()) return;
+	committed = _fb + _numcols * _numlines;
+
+	for (row = 0; row < _numlines; row++) {
+		for (col = 0; col < _numcols; col++) {
+			if (shadow[col] == committed[col]) continue;
+
+			addr = col + lcd_row_offsets[row];
+			if (addr != _ddramAddr) lcd_send(LCD_SETDDRAMADDR | addr, LOW);
+
+			// send the whole run of changed cells in this row as one write
+			for (run = col; run < _numcols && shadow[run] != committed[run]; run++) {
+				committed[run] = shadow[run];
+			}
+			lcd_sendData(&shadow[col], run - col);
+
+			// follow the LCD's address counter, which wraps between the two DDRAM lines
+			addr += run - col;
+			if (_numlines > 1) {
+				if (addr == 0x28) addr = 0x40;
+				else if (addr == 0x68) addr = 0x00;
+			}
+			else if (addr == 0x50) addr = 0x00;
+			_ddramAddr = addr;
+			col = run;
+		}
+		shadow += _numcols;
+		committed += _numcols;
+	}
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: attachQueue
+ * Description: Switch to asynchronous mode. write() and command() only encode their frames into
+ *              the ring; poll() sends them out one at a time as the LCD becomes ready, so the
+ *              caller never waits on a clear or home. When the ring is full the next frame
+ *              waits for poll() to make room. Call after begin(). An empty queue can never
+ *              make room, so a size of 0 acts as detachQueue().
+ * Ins: pointer to frame storage, number of frames it holds
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::attachQueue(LCDFrame *queue, uint8_t size) {
+	if (!queue || !size) {
+		if (_queue) detachQueue();
+		return;
+	}
+	_qSize = size;
+	_qHead = _qCount = _qHighWater = 0;
+	_queue = queue;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: detachQueue
+ * Description: Send everything still queued and go back to synchronous mode.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::detachQueue() {
+	while (poll()) ;
+	_queue = NULL;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: poll
+ * Description: Send the oldest queued frame if the LCD has finished the previous one. Never
+ *              waits on the LCD; call it from loop() as often as convenient.
+ * Ins: none
+ * Outs: number of frames still queued
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::poll() {
+	LCDFrame *frame;
+
+	if (!_queue) return 0;
+	if (_degraded && !_qCount) lcd_probe();  // keep probing or re-initializing while idle
+	if (!_qCount || (long)(micros() - _readyAt) < 0) return _qCount;
+
+	frame = &_queue[_qHead];
+	lcd_burstBytes(frame->bits, 4);
+	_readyAt = micros() + frame->wait;
+
+	if (++_qHead == _qSize) _qHead = 0;
+	return --_qCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: queued, queueSpace
+ * Description: Ring occupancy, for applications that want to hold off drawing while the
+ *              display is behind.
+ * Ins: none
+ * Outs: frames waiting / frames that can be added without blocking
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::queued() {
+	return _queue ? _qCount : 0;
+}
+
+uint8_t LCD::queueSpace() {
+	return _queue ? _qSize - _qCount : 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: highWater, clearHighWater
+ * Description: Deepest the ring has been since attachQueue() or the last clearHighWater().
+ *              A high water mark equal to the ring size means writers have been blocked.
+ * Ins: none
+ * Outs: peak number of queued frames
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::highWater() {
+	return _qHighWater;
+}
+
+void LCD::clearHighWater() {
+	_qHighWater = _qCount;
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -353,11 +566,136 @@ void LCD::noAutoscroll(void) {
  * Outs: none
  * ----------------------------------------------------------------------------------------------*/
 void LCD::createChar(uint8_t location, uint8_t charmap[]) {
+	uint8_t rows[8];
+	uint8_t hash;
+
 	location &= 0x7; // we only have 8 locations 0-7
+	hash = lcd_glyphRows(charmap, rows);
+	_glyphUsed[location] = ++_glyphTick;
+
+	// skip the upload if the slot already holds this bitmap
+	if ((_glyphValid & (1 << location)) && _glyphHash[location] == hash &&
+	    !memcmp(_glyphs[location], rows, 8)) return;
+
 	command(LCD_SETCGRAMADDR | (location << 3));
-	for (int i=0; i<8; i++) {
-		write(charmap[i]);
+	lcd_sendData(rows, 8);  // CGRAM data never goes through the framebuffer
+
+	memcpy(_glyphs[location], rows, 8);
+	_glyphHash[location] = hash;
+	_glyphValid |= 1 << location;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: loadGlyph
+ * Description: Make a custom character resident in CGRAM without managing slots by hand.
+ *              If the bitmap is already in a slot nothing is sent; otherwise it goes into a
+ *              free slot or, when all 8 are taken, the least recently used one. Slots filled
+ *              with createChar() take part in the same LRU.
+ * Ins: custom character array
+ * Outs: CGRAM slot (0-7) to write() to show the character
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::loadGlyph(const uint8_t charmap[]) {
+	uint8_t rows[8];
+	uint8_t hash, slot, i;
+
+	hash = lcd_glyphRows(charmap, rows);
+	for (i = 0; i < 8; i++) {
+		if ((_glyphValid & (1 << i)) && _glyphHash[i] == hash && !memcmp(_glyphs[i], rows, 8)) {
+			_glyphUsed[i] = ++_glyphTick;
+			return i;
+		}
+	}
+
+	// first free slot, else the one used longest ago
+	slot = 0;
+	for (i = 0; i < 8; i++) {
+		if (!(_glyphValid & (1 << i))) {
+			slot = i;
+			break;
+		}
+		if ((uint16_t)(_glyphTick - _glyphUsed[i]) > (uint16_t)(_glyphTick - _glyphUsed[slot])) slot = i;
+	}
+	createChar(slot, rows);
+	return slot;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: loadGlyph_P
+ * Description: loadGlyph() for a bitmap stored in flash with PROGMEM.
+ * Ins: custom character array in program memory
+ * Outs: CGRAM slot (0-7) to write() to show the character
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::loadGlyph_P(const uint8_t *charmap) {
+	uint8_t rows[8];
+
+	memcpy_P(rows, charmap, 8);
+	return loadGlyph(rows);
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: printBig
+ * Description: Print a number in 3x3 digits, one blank column between digits. The font lives
+ *              in flash and is loaded through the glyph cache, so only the first call uploads
+ *              it; it takes all 8 CGRAM slots. Each of the 3 rows goes out as one batched write.
+ * Ins: value, column and top row to draw at, minimum digits (zero padded)
+ * Outs: number of columns drawn
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::printBig(uint16_t value, uint8_t col, uint8_t row, uint8_t digits) {
+	uint8_t slot[8];
+	uint8_t digit[5];
+	uint8_t line[5 * 4];
+	uint8_t count = 0;
+	uint8_t i, r, k, n, cell;
+
+	if (digits > 5) digits = 5;
+	do {
+		digit[count++] = value % 10;
+		value /= 10;
+	} while (value || count < digits);
+
+	for (i = 0; i < 8; i++) slot[i] = loadGlyph_P(lcd_bigGlyphs[i]);
+
+	for (r = 0; r < 3; r++) {
+		n = 0;
+		for (i = count; i--; ) {
+			for (k = 0; k < 3; k++) {
+				cell = pgm_read_byte(&lcd_bigDigits[r][digit[i] * 3 + k]);
+				line[n++] = cell < 8 ? slot[cell] : cell;
+			}
+			if (i) line[n++] = ' ';
+		}
+		setCursor(col, row + r);
+		write(line, n);
+	}
+	return n;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: invalidateGlyphs
+ * Description: Forget what is in CGRAM, e.g. after the LCD lost power. The next createChar()
+ *              or loadGlyph() of each bitmap uploads it again.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::invalidateGlyphs() {
+	_glyphValid = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_glyphRows
+ * Description: Copy a character bitmap keeping only the 5 pixel columns the LCD uses, so
+ *              bitmaps that differ only in the unused bits compare equal.
+ * Ins: custom character array, buffer for the 8 masked rows
+ * Outs: hash of the masked rows, for a quick reject before comparing
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::lcd_glyphRows(const uint8_t *charmap, uint8_t *rows) {
+	uint8_t hash = 0;
+
+	for (uint8_t i = 0; i < 8; i++) {
+		rows[i] = charmap[i] & 0x1F;
+		hash = ((hash << 3) | (hash >> 5)) ^ rows[i];
 	}
+	return hash;
 }
 
 /*********** mid level commands, for sending data/cmds */
@@ -369,20 +707,68 @@ void LCD::createChar(uint8_t location, uint8_t charmap[]) {
  * Outs: none
  * ----------------------------------------------------------------------------------------------*/
 inline void LCD::command(uint8_t value) {
+	_ddramAddr = 0xFF;  // the command may have moved the address counter
 	lcd_send(value, LOW);
 }
 
 #if ARDUINO >= 100
 inline size_t LCD::write(uint8_t value) {
+	if (_fb) {
+		lcd_fbWrite(value);
+		return 1;
+	}
 	lcd_send(value, HIGH);
 	return 1;
 }
 #else
 inline void LCD::write(uint8_t value) {
+	if (_fb) {
+		lcd_fbWrite(value);
+		return;
+	}
 	lcd_send(value, HIGH);
 }
 #endif
 
+/*-----------------------------------------------------------------------------------------------
+ * Function: write
+ * Description: Write a run of characters. Print routes print() of strings and numbers here, so
+ *              text goes out several characters per I2C transaction instead of one.
+ * Ins: pointer to characters, number of characters
+ * Outs: number of characters written
+ * ----------------------------------------------------------------------------------------------*/
+#if ARDUINO >= 100
+size_t LCD::write(const uint8_t *buffer, size_t size) {
+#else
+void LCD::write(const uint8_t *buffer, size_t size) {
+#endif
+	size_t n;
+
+	if (_fb) {
+		for (n = 0; n < size; n++) lcd_fbWrite(buffer[n]);
+	}
+	else {
+		lcd_sendData(buffer, size);
+	}
+#if ARDUINO >= 100
+	return size;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_fbWrite
+ * Description: Store a character in the shadow screen and advance the framebuffer cursor.
+ *              Characters past the end of a row are dropped.
+ * Ins: character to store
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_fbWrite(uint8_t value) {
+	if (_fbCol < _numcols) {
+		_fb[_fbRow * _numcols + _fbCol] = value;
+		_fbCol++;
+	}
+}
+
 /************ low level data pushing commands **********/
 
 /*-----------------------------------------------------------------------------------------------
@@ -392,10 +778,315 @@ inline void LCD::write(uint8_t value) {
  * Outs: none
  * ----------------------------------------------------------------------------------------------*/
 void LCD::setBacklight(uint8_t status) {
+	uint8_t buf[4];
+
 	bitWrite(_displaycontrol,3,status); // flag that the backlight is enabled, for burst commands
+	if (_queue) {
+		// keep it in order with the queued frames, which carry the old backlight state
+		buf[0] = buf[1] = buf[2] = buf[3] = (_displaycontrol & LCD_BACKLIGHT)?0x80:0x00;
+		lcd_queueFrame(buf, 0);
+		return;
+	}
 	lcd_burstBits((_displaycontrol & LCD_BACKLIGHT)?0x80:0x00);
 }
 
+/*-----------------------------------------------------------------------------------------------
+ * Function: setExecTimes
+ * Description: Set how long the LCD takes to execute instructions. The board does not wire R/W,
+ *              so the busy flag can't be read back; the driver instead waits these times out as
+ *              deadlines and only stalls if the next instruction arrives early. Panels with a
+ *              fast oscillator can be trimmed towards the datasheet's 1520/37us.
+ * Ins: clear display/return home time, time of every other instruction, in microseconds
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::setExecTimes(uint16_t homeUs, uint16_t execUs) {
+	_homeUs = homeUs;
+	_execUs = execUs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: setClock
+ * Description: Set the I2C clock. On AVR TWBR is programmed directly (prescaler 1), which any
+ *              Arduino version can do; elsewhere Wire.setClock() is used where the core has it.
+ *              The clock is shared by everything on the bus.
+ * Ins: clock in Hz
+ * Outs: the clock actually set, which on AVR is the nearest TWBR step at or below hz
+ * ----------------------------------------------------------------------------------------------*/
+uint32_t LCD::setClock(uint32_t hz) {
+	_clockSet = lcd_applyClock(hz);
+	return _clockSet;
+}
+
+uint32_t LCD::busClock() {
+	return _clock;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: negotiateClock
+ * Description: Pick the fastest clock, up to maxHz, at which the expander reliably takes and
+ *              returns writes. Each candidate is checked by writing test patterns to DEFVAL and
+ *              reading them back, and any NACK moves on to the next slower clock. Call after
+ *              begin().
+ * Ins: fastest clock to try, in Hz
+ * Outs: the clock chosen, or 0 if even 100kHz failed (the bus is left at 100kHz)
+ * ----------------------------------------------------------------------------------------------*/
+uint32_t LCD::negotiateClock(uint32_t maxHz) {
+	uint8_t i;
+
+	for (i = LCD_CLOCKS; i--; ) {
+		if (lcd_clocks[i] > maxHz) continue;
+		setClock(lcd_clocks[i]);
+		if (lcd_verifyBus()) return _clock;
+	}
+	setClock(lcd_clocks[0]);
+	return 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: clockSweep
+ * Description: Benchmark the display at each I2C clock: fill the screen through the burst write
+ *              path and print a table of clock, whether readback passed, microseconds per screen
+ *              and characters per second. Overwrites and then clears the screen; call without a
+ *              framebuffer or queue attached. The clock is restored afterwards.
+ * Ins: where to print, e.g. Serial
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::clockSweep(Print &out) {
+	uint8_t line[40];
+	uint32_t previous = _clockSet;
+	unsigned long start, elapsed;
+	uint8_t cols = _numcols > sizeof(line) ? sizeof(line) : _numcols;
+	uint8_t i, row;
+
+	out.println("kHz verify us/screen chars/s");
+	for (i = 0; i < LCD_CLOCKS; i++) {
+		setClock(lcd_clocks[i]);
+		out.print(_clock / 1000);
+		if (!lcd_verifyBus()) {
+			out.println(" failed");
+			continue;
+		}
+
+		memset(line, 'A' + i, cols);
+		start = micros();
+		for (row = 0; row < _numlines; row++) {
+			setCursor(0, row);
+			write(line, cols);
+		}
+		elapsed = micros() - start;
+
+		out.print(" ok ");
+		out.print(elapsed);
+		out.print(' ');
+		out.println((unsigned long)cols * _numlines * 1000000UL / elapsed);
+	}
+	setClock(previous);
+	clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: setRetry
+ * Description: Bound how hard a failed transfer is retried before the LCD is degraded. While
+ *              degraded every frame is dropped without touching the bus, except for a probe
+ *              every LCD_PROBE_MS; a display fault never holds up the rest of the sketch.
+ * Ins: retries after the first attempt, time budget for all attempts in microseconds
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::setRetry(uint8_t retries, uint16_t timeoutUs) {
+	_retries = retries;
+	_timeoutUs = timeoutUs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: healthy
+ * Description: Whether the panel is being written to, as opposed to degraded.
+ * Ins: none
+ * Outs: false while frames are being dropped
+ * ----------------------------------------------------------------------------------------------*/
+bool LCD::healthy() {
+	return !_degraded;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: errors, clearErrors
+ * Description: I2C error counters, see LCDErrors.
+ * Ins: none
+ * Outs: the counters
+ * ----------------------------------------------------------------------------------------------*/
+const LCDErrors &LCD::errors() {
+	return _errors;
+}
+
+void LCD::clearErrors() {
+	memset(&_errors, 0, sizeof(_errors));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: stats, clearStats
+ * Description: Traffic and timing counters, see LCDStats. Only recorded when built with
+ *              LCD_STATS set to 1; otherwise they read as zero.
+ * Ins: none
+ * Outs: the counters
+ * ----------------------------------------------------------------------------------------------*/
+const LCDStats &LCD::stats() {
+	return _stats;
+}
+
+void LCD::clearStats() {
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: printStats
+ * Description: Print the counters on one line with no line ending, so the output also fits on
+ *              an LCD: transactions, bytes, commands, data, send calls, total and longest send
+ *              time in microseconds.
+ * Ins: where to print, e.g. Serial or an LCD
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::printStats(Print &out) {
+#if LCD_STATS
+	LCDStats now = _stats;  // printing to ourselves would change them as we go
+
+	out.print("tx=");
+	out.print(now.transactions);
+	out.print(" B=");
+	out.print(now.bytes);
+	out.print(" cmd=");
+	out.print(now.commands);
+	out.print(" dat=");
+	out.print(now.data);
+	out.print(" n=");
+	out.print(now.sends);
+	out.print(" us=");
+	out.print(now.sendMicros);
+	out.print(" max=");
+	out.print(now.maxSendMicros);
+#else
+	out.print("LCD_STATS off");
+#endif
+}
+
+#if LCD_STATS
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_statSend
+ * Description: Account one lcd_send()/lcd_sendData() call.
+ * Ins: micros() when the call started
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_statSend(unsigned long started) {
+	unsigned long elapsed = micros() - started;
+
+	_stats.sends++;
+	_stats.sendMicros += elapsed;
+	if (elapsed > _stats.maxSendMicros) _stats.maxSendMicros = elapsed;
+}
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: setWarmStart
+ * Description: Let begin() check whether the expander and LCD kept power across an MCU reset
+ *              (watchdog, reset button) and, if so, skip the power-on delays and full reset and
+ *              only reassert the LCD modes. The screen contents are kept. Call before begin().
+ * Ins: true to enable
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::setWarmStart(bool enable) {
+	_warmStart = enable;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: warmStarted
+ * Description: Whether the last begin() found the display already configured.
+ * Ins: none
+ * Outs: true if begin() took the warm path
+ * ----------------------------------------------------------------------------------------------*/
+bool LCD::warmStarted() {
+	return _warm;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: setButtons
+ * Description: Use spare expander pins as buttons to ground: inputs with the internal pull-up,
+ *              inverted so a pressed button reads 1, interrupting on any change. Wire the
+ *              expander's INT pin to an interrupt pin on the Arduino and call buttonInterrupt()
+ *              from its handler; pollButtons() then only touches the bus when a button moved.
+ *              Pins the LCD uses are left alone. Call before begin() to keep setWarmStart()
+ *              working, since begin() checks the pin directions.
+ *
+ *                lcd.setButtons(LCD_BUTTON_PINS);
+ *                lcd.begin(20, 4);
+ *                attachInterrupt(0, onButton, FALLING);   // void onButton() { lcd.buttonInterrupt(); }
+ * Ins: pins, bit n for GPn
+ * Outs: the pins actually set up as buttons
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::setButtons(uint8_t pins) {
+	uint8_t result;
+
+	_buttonMask = pins & LCD_BUTTON_PINS;
+	_buttons = 0;
+	_buttonPending = false;
+	if (_numcols) {
+		result = lcd_buttonConfig();
+		if (!result) result = lcd_writeRegister(MCP23008_IODIR, _buttonMask);
+		if (result) lcd_countError(result);
+	}
+	return _buttonMask;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: buttonInterrupt
+ * Description: Note that the expander signalled a change. Safe to call from an interrupt
+ *              handler: it only sets a flag for pollButtons().
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::buttonInterrupt() {
+	_buttonIrq = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: pollButtons
+ * Description: Call from loop(). After an interrupt, reads INTCAP once, which releases INT so
+ *              contact bounce interrupts again and just restarts the debounce period. Once the
+ *              pins have been quiet for LCD_DEBOUNCE_MS, GPIO is read once to confirm where
+ *              they settled. Without an interrupt the bus isn't touched at all.
+ * Ins: none
+ * Outs: buttons that changed since the last event; buttons() tells pressed from released
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::pollButtons() {
+	int value;
+	uint8_t changed;
+
+	if (!_buttonMask || _degraded) return 0;
+
+	if (_buttonIrq) {
+		_buttonIrq = false;
+		lcd_readRegister(MCP23008_INTCAP);
+		_buttonPending = true;
+		_buttonAt = millis();
+		return 0;
+	}
+	if (!_buttonPending || millis() - _buttonAt < LCD_DEBOUNCE_MS) return 0;
+
+	_buttonPending = false;
+	value = lcd_readRegister(MCP23008_GPIO);
+	if (value < 0) return 0;
+	changed = (value ^ _buttons) & _buttonMask;
+	_buttons = value & _buttonMask;
+	return changed;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: buttons
+ * Description: Debounced button state as of the last pollButtons() event.
+ * Ins: none
+ * Outs: bit set for each button held down
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::buttons() {
+	return _buttons;
+}
+
 /*-----------------------------------------------------------------------------------------------
  * Function: lcd_send
  * Description: Write either command or data, burst it to the expander over I2C.
@@ -403,6 +1094,53 @@ void LCD::setBacklight(uint8_t status) {
  * Outs: none
  * ----------------------------------------------------------------------------------------------*/
 void LCD::lcd_send(uint8_t value, uint8_t mode) {
+	byte buf[4];
+	LCD_STAT(unsigned long started = micros());
+
+	lcd_encode(value, mode, buf);
+
+	// clear display and return home are the only slow instructions
+	lcd_queueFrame(buf, (!mode && value < 4) ? _homeUs : _execUs);
+	LCD_STAT(lcd_statSend(started));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_sendData
+ * Description: Write a run of data bytes. Synchronously, as many characters as fit in the Wire
+ *              buffer go out in each I2C transaction; with a queue attached each character
+ *              becomes one frame.
+ * Ins: pointer to data, number of bytes
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_sendData(const uint8_t *values, size_t count) {
+	byte buf[LCD_BURST_CHARS * 4];
+	uint8_t n;
+	LCD_STAT(unsigned long started = micros());
+
+	if (_queue) {
+		while (count--) lcd_send(*values++, HIGH);
+		return;
+	}
+
+	while (count) {
+		for (n = 0; count && n < LCD_BURST_CHARS; n++, count--) {
+			lcd_encode(*values++, HIGH, &buf[n * 4]);
+		}
+
+		while (!_degraded && (long)(micros() - _readyAt) < 0) ;
+		lcd_burstBytes(buf, n * 4);
+		_readyAt = micros() + _execUs;
+	}
+	LCD_STAT(lcd_statSend(started));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_encode
+ * Description: Turn a command or data byte into the four GPIO states that clock it into the LCD.
+ * Ins: value and mode to send command/data, buffer for the four states
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_encode(uint8_t value, uint8_t mode, uint8_t *buf) {
 	// BURST SPEED, OH MY GOD
 	// the (now High Speed!) I/O expander pinout
 	// RS pin = 1
@@ -411,47 +1149,232 @@ void LCD::lcd_send(uint8_t value, uint8_t mode) {
 	// Data pin 5 = 4
 	// Data pin 6 = 5
 	// Data pin 7 = 6
-	byte buf;
-	
-  // crunch the high 4 bits
-	// isolate high 4 bits, shift over to data pins (bits 6-3: x1111xxx)
-  buf = (value & B11110000) >> 1; 
-	
-  // here we can just enable enable, since the value is immediately written to the pins
-  if (mode) buf |= 3 << 1; 
+	byte ctrl;
 	
+	LCD_STAT(if (mode) _stats.data++; else _stats.commands++);
+
   // if RS (mode), turn RS and enable on. otherwise, just enable. (bits 2-1: xxxxx11x)
-  else buf |= 2 << 1; 
+  // here we can just enable enable, since the value is immediately written to the pins
+  ctrl = mode ? 3 << 1 : 2 << 1;
 	
   // using DISPLAYCONTROL command to mask backlight bit in _displaycontrol
-  buf |= (_displaycontrol & LCD_BACKLIGHT)?0x80:0x00; 
+  ctrl |= (_displaycontrol & LCD_BACKLIGHT)?0x80:0x00; 
 	
-  lcd_burstBits(buf); // bits are now present at LCD with enable active in the same write
+  // crunch the high 4 bits
+	// isolate high 4 bits, shift over to data pins (bits 6-3: x1111xxx)
+  buf[0] = ((value & B11110000) >> 1) | ctrl; // bits present at LCD with enable active
 	
   // no need to delay since these things take WAY, WAY longer than the time required for enable 
   // to settle (1us in LCD implementation?)
-	buf &= ~(1<<2); // toggle enable low
-	
-  lcd_burstBits(buf); // send out the same bits but with enable low now; LCD crunches these 4 bits.
+  buf[1] = buf[0] & ~(1<<2); // same bits with enable low; LCD crunches these 4 bits.
 	
   // crunch the low 4 bits
   // isolate low 4 bits, shift over to data pins (bits 6-3: x1111xxx)
-	buf = (value & B1111) << 3; 
-	
-  // here we can just enable enable, since the value is immediately written to the pins
-  if (mode) buf |= 3 << 1; 
-	
-  // if RS (mode), turn RS and enable on. otherwise, just enable. (bits 2-1: xxxxx11x)
-  else buf |= 2 << 1; 
-	
-  // using DISPLAYCONTROL command to mask backlight bit in _displaycontrol
-  buf |= (_displaycontrol & LCD_BACKLIGHT)?0x80:0x00; 
-	
-  lcd_burstBits(buf);
+	buf[2] = ((value & B1111) << 3) | ctrl;
 	
   // toggle enable low (1<<2 = 00000100; NOT = 11111011; with "and", this turns off only that one bit)
-  buf &= ~( 1 << 2 ); 
-	lcd_burstBits(buf);
+  buf[3] = buf[2] & ~( 1 << 2 ); 
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_queueFrame
+ * Description: Hand one encoded byte to the LCD. Synchronously it waits out the previous
+ *              instruction's deadline and bursts the frame; with a queue attached it is
+ *              stored for poll().
+ * Ins: the four GPIO states, execution time of the instruction in microseconds
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_queueFrame(const uint8_t *bits, uint16_t wait) {
+	LCDFrame *frame;
+	uint8_t tail;
+
+	if (_queue) {
+		while (_qCount == _qSize) poll();  // full: make room
+
+		tail = _qHead + _qCount;
+		if (tail >= _qSize) tail -= _qSize;
+		frame = &_queue[tail];
+		memcpy(frame->bits, bits, 4);
+		frame->wait = wait;
+		if (++_qCount > _qHighWater) _qHighWater = _qCount;
+		return;
+	}
+
+	// a degraded LCD drops the frame, or runs a recovery step that keeps its own deadlines
+	while (!_degraded && (long)(micros() - _readyAt) < 0) ;
+
+	// IOCON.SEQOP is set in begin(), so all four states land on GPIO in one transaction
+	lcd_burstBytes(bits, 4);
+	_readyAt = micros() + wait;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_resetNibble
+ * Description: Clock one nibble of the 8 bit software reset into the LCD, then let it execute.
+ * Ins: GPIO state with EN low, execution time of the nibble in microseconds
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_resetNibble(uint8_t bits, uint16_t wait) {
+	byte buf[2];
+
+	buf[0] = bits | (1<<2); // with enable
+	buf[1] = bits;          // and !enable, the LCD latches here
+
+	while ((long)(micros() - _readyAt) < 0) ;
+	lcd_burstBytes(buf, 2);
+	_readyAt = micros() + wait;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_readRegister
+ * Description: Read one expander register. With IOCON.SEQOP set the address pointer doesn't
+ *              increment, so registers are read one at a time.
+ * Ins: register address
+ * Outs: register value, or -1 if the expander didn't answer
+ * ----------------------------------------------------------------------------------------------*/
+int LCD::lcd_readRegister(uint8_t reg) {
+	Wire.beginTransmission(MCP23008_ADDRESS | lcd_i2cAddr);
+#if ARDUINO >= 100
+	Wire.write(reg);
+#else
+	Wire.send(reg);
+#endif
+	if (Wire.endTransmission()) return -1;
+	LCD_STAT(_stats.transactions++);
+	LCD_STAT(_stats.bytes += 2);
+	if (Wire.requestFrom((uint8_t)(MCP23008_ADDRESS | lcd_i2cAddr), (uint8_t)1) != 1) return -1;
+	LCD_STAT(_stats.transactions++);
+	LCD_STAT(_stats.bytes += 2);
+#if ARDUINO >= 100
+	return Wire.read();
+#else
+	return Wire.receive();
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_writeRegister
+ * Description: Write one expander register.
+ * Ins: register address, value
+ * Outs: Wire.endTransmission() result, 0 on success
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::lcd_writeRegister(uint8_t reg, uint8_t value) {
+	uint8_t result;
+
+	Wire.beginTransmission(MCP23008_ADDRESS | lcd_i2cAddr);
+#if ARDUINO >= 100
+	Wire.write(reg);
+	Wire.write(value);
+#else
+	Wire.send(reg);
+	Wire.send(value);
+#endif
+	result = Wire.endTransmission();
+	LCD_STAT(if (!result) _stats.transactions++);
+	LCD_STAT(if (!result) _stats.bytes += 3);
+	return result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_verifyBus
+ * Description: Check that writes land at the current clock by round tripping two complementary
+ *              patterns through DEFVAL, which only matters for interrupt-on-change against a
+ *              default value, then putting it back to 0.
+ * Ins: none
+ * Outs: true if every write was acknowledged and read back intact
+ * ----------------------------------------------------------------------------------------------*/
+bool LCD::lcd_verifyBus() {
+	static const uint8_t patterns[] = { 0x55, 0xAA };
+	uint8_t i;
+
+	for (i = 0; i < sizeof(patterns); i++) {
+		if (lcd_writeRegister(MCP23008_DEFVAL, patterns[i])) return false;
+		if (lcd_readRegister(MCP23008_DEFVAL) != patterns[i]) return false;
+	}
+	return !lcd_writeRegister(MCP23008_DEFVAL, 0x00);
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_applyClock
+ * Description: Program the I2C clock without changing the one chosen with setClock(), so a
+ *              clock stepped down after errors can be put back.
+ * Ins: clock in Hz
+ * Outs: the clock actually set
+ * ----------------------------------------------------------------------------------------------*/
+uint32_t LCD::lcd_applyClock(uint32_t hz) {
+#if defined(TWBR)
+	uint32_t twbr = 0;
+
+	if (F_CPU / hz > 16) twbr = (F_CPU / hz - 16 + 1) / 2;
+	if (twbr > 255) twbr = 255;
+	TWSR &= ~((1<<TWPS1) | (1<<TWPS0));
+	TWBR = twbr;
+	_clock = F_CPU / (16 + 2 * twbr);
+#elif ARDUINO >= 157
+	Wire.setClock(hz);
+	_clock = hz;
+#endif
+	return _clock;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_clockDown
+ * Description: Drop to the next slower clock in the negotiation list after a failed transfer.
+ * Ins: none
+ * Outs: false if already at the slowest clock
+ * ----------------------------------------------------------------------------------------------*/
+bool LCD::lcd_clockDown() {
+	uint8_t i;
+
+	for (i = LCD_CLOCKS; i--; ) {
+		if (lcd_clocks[i] < _clock) {
+			lcd_applyClock(lcd_clocks[i]);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_configured
+ * Description: Check whether the expander still holds what begin() programmed into it. At power
+ *              on IODIR is 0xFF and IOCON 0x00, so a match means it, and the LCD sharing its
+ *              supply, stayed powered. OLAT must also show EN low, i.e. no transfer in progress.
+ * Ins: none
+ * Outs: true if the expander is configured for the LCD
+ * ----------------------------------------------------------------------------------------------*/
+bool LCD::lcd_configured() {
+	int olat;
+
+	if (lcd_readRegister(MCP23008_IODIR) != _buttonMask) return false;
+	if (lcd_readRegister(MCP23008_IOCON) != MCP23008_IOCON_SEQOP) return false;
+	olat = lcd_readRegister(MCP23008_OLAT);
+	return olat >= 0 && !(olat & (1<<2));
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_buttonConfig
+ * Description: Program the button pins: pull-ups, inverted input, interrupt on change from the
+ *              previous level. IODIR is left to the caller. The current state is read back,
+ *              which also clears any interrupt already pending.
+ * Ins: none
+ * Outs: Wire.endTransmission() result of the first failed write, 0 on success
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::lcd_buttonConfig() {
+	uint8_t result;
+	int value;
+
+	result = lcd_writeRegister(MCP23008_GPPU, _buttonMask);
+	if (!result) result = lcd_writeRegister(MCP23008_IPOL, _buttonMask);
+	if (!result) result = lcd_writeRegister(MCP23008_INTCON, 0x00);
+	if (!result) result = lcd_writeRegister(MCP23008_GPINTEN, _buttonMask);
+	if (result) return result;
+
+	value = lcd_readRegister(MCP23008_GPIO);
+	_buttons = value < 0 ? 0 : value & _buttonMask;
+	_buttonIrq = false;
+	_buttonPending = false;
+	return 0;
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -462,13 +1385,320 @@ void LCD::lcd_send(uint8_t value, uint8_t mode) {
  * ----------------------------------------------------------------------------------------------*/
 void LCD::lcd_burstBits(uint8_t value) {
 	// we use this to burst bits to the GPIO chip whenever we need to. avoids repetative code.
-	Wire.beginTransmission(MCP23008_ADDRESS | lcd_i2cAddr);
+	lcd_burstBytes(&value, 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_burstBytes
+ * Description: Burst a sequence of GPIO states to the expander in one I2C transaction.
+ *              Relies on IOCON.SEQOP being set so every byte is written to MCP23008_GPIO.
+ *              A failed transfer is retried within the setRetry() limits, then the frame is
+ *              dropped and the LCD degraded. While degraded, frames are dropped straight away
+ *              until a probe finds the expander again. A transfer too long for Wire's buffer
+ *              can never succeed, so it is dropped without a retry.
+ * Ins: pointer to GPIO states, number of states (at most BUFFER_LENGTH - 1)
+ * Outs: true if the expander took the transfer
+ * ----------------------------------------------------------------------------------------------*/
+bool LCD::lcd_burstBytes(const uint8_t *values, uint8_t count) {
+	unsigned long start;
+	uint8_t attempt, result, i;
+
+	if (_degraded && !lcd_probe()) {
+		_errors.dropped++;
+		return false;
+	}
+
+	// Wire empties its buffer in endTransmission(), so a retry has to rebuild the transaction.
+	// A bus error usually means the bus can't keep up, so those retries go one clock step
+	// slower. An unanswered address is a missing panel, not a slow bus, and the clock is shared
+	// with every other device, so it stays put. A refused data byte isn't retried at all: the
+	// states before it reached the LCD, maybe half a byte, and sending the burst again would
+	// clock that nibble in twice. The panel is degraded instead and resynchronized on recovery.
+	start = micros();
+	for (attempt = 0; ; attempt++) {
+		Wire.beginTransmission(MCP23008_ADDRESS | lcd_i2cAddr);
+#if ARDUINO >= 100
+		Wire.write((byte)MCP23008_GPIO);
+		for (i = 0; i < count; i++) Wire.write(values[i]);
+#else
+		Wire.send(MCP23008_GPIO);
+		for (i = 0; i < count; i++) Wire.send(values[i]);
+#endif
+		result = Wire.endTransmission();
+		if (!result) {
+			LCD_STAT(_stats.transactions++);
+			LCD_STAT(_stats.bytes += count + 2);
+			return true;
+		}
+
+		lcd_countError(result);
+		if (result == 1) {
+			_errors.dropped++;
+			return false;
+		}
+		if (result == 3) {
+			_resync = true;
+			break;
+		}
+		if (attempt >= _retries) break;
+		if (micros() - start >= _timeoutUs) {
+			_errors.timeouts++;
+			break;
+		}
+		if (result == 4) lcd_clockDown();
+	}
+
+	_errors.dropped++;
+	lcd_degrade();
+	return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_busBegin
+ * Description: Start Wire at our clock. Where the core supports it, also bound how long Wire
+ *              itself may wait on a stuck bus, which would otherwise hang inside endTransmission().
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_busBegin() {
+	Wire.begin();
+	lcd_applyClock(_clockSet);  // Wire.begin() goes back to 100kHz
+#if defined(WIRE_HAS_TIMEOUT)
+	Wire.setWireTimeout(LCD_WIRE_TIMEOUT_US, true);
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_countError
+ * Description: Count a failed transfer by its Wire.endTransmission() code.
+ * Ins: error code
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_countError(uint8_t code) {
+	switch (code) {
+		case 2: _errors.nackAddress++; break;
+		case 3: _errors.nackData++; break;
+		case 5: _errors.timeouts++; break;
+		default: _errors.busErrors++; break;
+	}
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_degrade
+ * Description: Stop talking to the panel until the next probe.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_degrade() {
+	_degraded = true;
+	_probeAt = micros() + LCD_PROBE_MS * 1000UL;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_probe
+ * Description: While degraded, check whether the expander answers again, at most once every
+ *              LCD_PROBE_MS, and recover if it does. While a panel that lost power is being
+ *              initialized again, each call instead runs the next step of that once it is due.
+ * Ins: none
+ * Outs: true if the panel is usable again
+ * ----------------------------------------------------------------------------------------------*/
+bool LCD::lcd_probe() {
+	if ((long)(micros() - _probeAt) < 0) return false;
+	if (_initStep) {
+		if (!lcd_initStep()) return false;
+		lcd_recovered();
+		return true;
+	}
+	if (lcd_readRegister(MCP23008_IODIR) < 0) {
+		lcd_degrade();
+		return false;
+	}
+	lcd_recover();
+	return !_degraded;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_recover
+ * Description: The expander answered a probe. If it kept its configuration the panel is usable
+ *              once the custom characters are uploaded again, since the cache took uploads the
+ *              degraded panel never saw. If it lost power meanwhile it is back at its power-on
+ *              state, and after a refused data byte the LCD may be between nibbles, so the
+ *              panel is initialized again. Either runs one lcd_initStep() per probe while it
+ *              stays degraded; no single write(), flush() or poll() waits out the delays.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_recover() {
+	if (_clock != _clockSet) lcd_applyClock(_clockSet);  // undo any steps down on the way out
+
+	if (!lcd_configured()) {
+		lcd_initStart();
+	}
+	else if (_resync) {
+		// powered throughout but maybe between nibbles: the same reset, without the power-on wait
+		lcd_initStart();
+		_probeAt = micros();
+	}
+	else if (_glyphValid) {
+		// CGRAM kept its contents, but uploads made while degraded were dropped: replay the
+		// custom characters, a step per probe as after a power cycle
+		_initStep = 7;
+		_degraded = true;
+		_probeAt = micros();
+	}
+	else {
+		lcd_recovered();
+	}
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_recovered
+ * Description: The panel takes frames again. Frames were dropped while it was degraded, so the
+ *              whole framebuffer is marked for the next flush().
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_recovered() {
+	uint8_t *committed;
+	uint16_t i, size;
+
+	_degraded = false;
+	_errors.recoveries++;
+
+	if (_fb) {
+		size = _numcols * _numlines;
+		committed = _fb + size;
+		for (i = 0; i < size; i++) committed[i] = ~_fb[i];
+	}
+	_ddramAddr = 0xFF;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: resetExpander
+ * Description: Put every MCP23008 register from IODIR to OLAT back to its power-on value in one
+ *              burst, with a boatload of junk data: all inputs, no inversion, interrupts or
+ *              pull-ups. An expander that kept other settings across an MCU reset starts clean.
+ * Ins: full I2C address of the expander
+ * Outs: Wire.endTransmission() result
+ * ----------------------------------------------------------------------------------------------*/
+uint8_t LCD::resetExpander(uint8_t address) {
+	uint8_t i;
+
+	Wire.beginTransmission(address);
 #if ARDUINO >= 100
-	Wire.write(MCP23008_GPIO);
-	Wire.write(value); // last bits are crunched, we're done.
+	Wire.write((byte)MCP23008_IODIR);
+	Wire.write((byte)0xFF);
+	for (i = MCP23008_IPOL; i <= MCP23008_OLAT; i++) Wire.write((byte)0x00);
 #else
-	Wire.send(MCP23008_GPIO);
-	Wire.send(value); // last bits are crunched, we're done.
+	Wire.send(MCP23008_IODIR);
+	Wire.send(0xFF);
+	for (i = MCP23008_IPOL; i <= MCP23008_OLAT; i++) Wire.send(0x00);
 #endif
-	while (Wire.endTransmission()) ;
-}
\ No newline at end of file
+	return Wire.endTransmission();
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_initStart
+ * Description: Start the power-on initialization of lcd_initStep(). The LCD counts as degraded
+ *              until the last step, so nothing else reaches the bus in between.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCD::lcd_initStart() {
+	_initStep = 1;
+	_resync = false;            // the reset nibbles resynchronize the 4 bit interface
+	_degraded = true;
+	_probeAt = micros() + LCD_POWERUP_US;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: lcd_initStep
+ * Description: Run the next step of the power-on initialization; call once _probeAt has passed.
+ *              Each step sends a few frames at most and leaves its wait in _probeAt, so the
+ *              datasheet delays are deadlines between calls instead of time spent in one.
+ *              The modes in _displaycontrol and _displaymode and every custom character we
+ *              know of are restored on the way, so the same steps serve begin() and recovery.
+ * Ins: none
+ * Outs: true once the last step is done, false if there are more or the panel went away
+ * ----------------------------------------------------------------------------------------------*/
+bool LCD::lcd_initStep() {
+	uint8_t *fb = _fb;
+	LCDFrame *queue = _queue;
+	uint8_t result, slot;
+	bool done = false;
+
+	// the steps have to reach the panel directly, not the framebuffer or queue
+	_fb = NULL;
+	_queue = NULL;
+	_degraded = false;
+
+	switch (_initStep) {
+	case 1:
+		// first thing we do is get the GPIO expander's head working straight
+		result = resetExpander(MCP23008_ADDRESS | lcd_i2cAddr);  // its own result doesn't matter
+		LCD_STAT(if (!result) _stats.transactions++);
+		LCD_STAT(if (!result) _stats.bytes += 12);
+
+		// now we set the GPIO expander's I/O direction to output since it's soldered to an LCD
+		// output, then turn off sequential addressing so a multi-byte write keeps hitting GPIO.
+		// This lets lcd_send() push all four nibble states of a byte in a single I2C transaction.
+		result = lcd_writeRegister(MCP23008_IOCON, MCP23008_IOCON_SEQOP);
+		if (!result && _buttonMask) result = lcd_buttonConfig();
+		if (!result) result = lcd_writeRegister(MCP23008_IODIR, _buttonMask); // all output but buttons
+		if (result) {
+			lcd_countError(result);
+			lcd_degrade();
+			break;
+		}
+
+		// put the LCD into 4 bit mode with the software reset of page 45 of the HD44780
+		// datasheet, since we cannot assume it was powered at the same time as the arduino.
+		// bit pattern for lcd_resetNibble() is
+		//
+		//  7   6   5   4   3   2   1   0
+		// LT  D7  D6  D5  D4  EN  RS  n/c
+		lcd_resetNibble(B10011000, LCD_RESET1_US); // LITE D4 D5 high: 0011
+		break;
+	case 2:
+		lcd_resetNibble(B10011000, LCD_RESET2_US); // repeat twice more
+		break;
+	case 3:
+		lcd_resetNibble(B10011000, _execUs);
+		break;
+	case 4:
+		lcd_resetNibble(B10010000, _execUs);       // D4 low and LITE D5 high: 0010, 4 bit mode
+		break;
+	case 5:
+		command(LCD_FUNCTIONSET | _displayfunction); // 0010NF00 (N=lines, F=font)
+		command(LCD_DISPLAYCONTROL | _displaycontrol);
+		command(LCD_CLEARDISPLAY);
+		break;
+	case 6:
+		command(LCD_ENTRYMODESET | _displaymode);
+		setBacklight((_displaycontrol & LCD_BACKLIGHT) ? HIGH : LOW);
+		break;
+	default:
+		// then the custom characters, one per step
+		for (slot = _initStep - 7; slot < 8 && !(_glyphValid & (1 << slot)); slot++) ;
+		if (slot == 8) {
+			done = true;
+			break;
+		}
+		command(LCD_SETCGRAMADDR | (slot << 3));
+		lcd_sendData(_glyphs[slot], 8);
+		_initStep = slot + 7;
+		break;
+	}
+
+	_fb = fb;
+	_queue = queue;
+	if (_degraded || done) {
+		// finished, or the panel went away again and lcd_degrade() has scheduled a probe
+		_initStep = 0;
+		return done;
+	}
+	_initStep++;
+	_degraded = true;
+	_probeAt = _readyAt;
+	return false;
+}
@@ -41,6 +41,9 @@
 #define MCP23008_GPIO 0x09
 #define MCP23008_OLAT 0x0A
 
+// IOCON bits
+#define MCP23008_IOCON_SEQOP 0x20 // 1 = address pointer does not increment
+
 // commands
 #define LCD_CLEARDISPLAY 0x01
 #define LCD_RETURNHOME 0x02
@@ -80,6 +83,91 @@
 #define LCD_1LINE 0x00
 #define LCD_5x10DOTS 0x04
 #define LCD_5x8DOTS 0x00
+
+// HD44780 execution times in microseconds. The datasheet gives 1.52ms for clear display and
+// return home and 37us for everything else at 270kHz; the defaults leave room for slow
+// oscillators and can be tuned per panel with setExecTimes().
+#define LCD_HOME_US 2000
+#define LCD_EXEC_US 37
+
+// I2C clock. The MCP23008 is rated for 400kHz. Beyond about 970kHz the characters of one
+// burst (36 bits each) would reach the LCD faster than its 37us execution time.
+#define LCD_DEFAULT_CLOCK 100000UL
+#ifndef LCD_MAX_CLOCK
+#define LCD_MAX_CLOCK 400000UL
+#endif
+
+// wait after power-up before the first instruction (datasheet: 40ms after Vcc reaches 2.7V)
+#define LCD_POWERUP_US 50000UL
+
+// waits after the first and second function set of the software reset (datasheet fig. 24)
+#define LCD_RESET1_US 4100
+#define LCD_RESET2_US 100
+
+// one queued lcd_send(): the four GPIO states and how long the LCD is busy afterwards
+typedef struct {
+  uint8_t bits[4];
+  uint16_t wait;   // microseconds before the next frame may be sent
+} LCDFrame;
+
+// I2C transfer errors, counted since the LCD was constructed or clearErrors()
+typedef struct {
+  unsigned long nackAddress;  // no expander answered the address (endTransmission() 2)
+  unsigned long nackData;     // the expander refused a data byte (3)
+  unsigned long busErrors;    // any other Wire error (1, 4)
+  unsigned long timeouts;     // the bus hung (5), or retries ran out of time
+  unsigned long dropped;      // frames given up on, including everything sent while degraded
+  unsigned long recoveries;   // times the panel answered again after being degraded
+} LCDErrors;
+
+// failed transfers are retried up to LCD_RETRIES times within LCD_TIMEOUT_US, after that the
+// LCD is degraded: frames are dropped and the panel is probed every LCD_PROBE_MS
+#ifndef LCD_RETRIES
+#define LCD_RETRIES 3
+#endif
+#ifndef LCD_TIMEOUT_US
+#define LCD_TIMEOUT_US 5000
+#endif
+#ifndef LCD_PROBE_MS
+#define LCD_PROBE_MS 500
+#endif
+// how long Wire may wait on a stuck bus, on cores that support Wire.setWireTimeout()
+#define LCD_WIRE_TIMEOUT_US 25000
+
+// Compile-time opt-in instrumentation. Build the library with -DLCD_STATS=1 to record
+// LCDStats; at 0 none of the counting code is compiled in. Only the counting depends on it,
+// the class layout doesn't, so a sketch that sees a different setting still links safely.
+#ifndef LCD_STATS
+#define LCD_STATS 0
+#endif
+
+#if LCD_STATS
+#define LCD_STAT(x) x
+#else
+#define LCD_STAT(x)
+#endif
+
+// I2C traffic and time spent sending, counted since the LCD was constructed or clearStats()
+typedef struct {
+  unsigned long transactions;   // I2C transactions that got through, register access included
+  unsigned long bytes;          // bytes on the wire, address and register included
+  unsigned long commands;       // instruction bytes sent
+  unsigned long data;           // data bytes sent
+  unsigned long sends;          // lcd_send()/lcd_sendData() calls
+  unsigned long sendMicros;     // total time in them, waits on the LCD included
+  unsigned long maxSendMicros;  // longest single call
+} LCDStats;
+
+// expander pins the LCD doesn't use (GP0 on the Hobbybotics board), free for buttons
+#define LCD_BUTTON_PINS 0x01
+
+// how long a button must stay put after its last change before it counts
+#ifndef LCD_DEBOUNCE_MS
+#define LCD_DEBOUNCE_MS 20
+#endif
+
+// bytes needed for the optional framebuffer (shadow + committed copy of the screen)
+#define LCD_FRAMEBUFFER_SIZE(cols, rows) (2 * (cols) * (rows))
  
 class LCD : public Print {
   public:
@@ -104,26 +192,125 @@ class LCD : public Print {
     void autoscroll();
     void noAutoscroll();
     void setBacklight(uint8_t status); 
+    void setExecTimes(uint16_t homeUs, uint16_t execUs);
+    uint32_t setClock(uint32_t hz);
+    uint32_t negotiateClock(uint32_t maxHz = LCD_MAX_CLOCK);
+    uint32_t busClock();
+    void clockSweep(Print &);
+    void setRetry(uint8_t retries, uint16_t timeoutUs);
+    bool healthy();
+    const LCDErrors &errors();
+    void clearErrors();
+    const LCDStats &stats();
+    void clearStats();
+    void printStats(Print &);
+    void setWarmStart(bool);
+    bool warmStarted();
+    uint8_t setButtons(uint8_t pins);
+    void buttonInterrupt();
+    uint8_t pollButtons();
+    uint8_t buttons();
     void createChar(uint8_t, uint8_t[]);
+    uint8_t loadGlyph(const uint8_t[]);
+    uint8_t loadGlyph_P(const uint8_t *);
+    uint8_t printBig(uint16_t value, uint8_t col, uint8_t row = 0, uint8_t digits = 0);
+    void invalidateGlyphs();
     void setCursor(uint8_t, uint8_t); 
     
+    void attachFramebuffer(uint8_t *);
+    void detachFramebuffer();
+    void flush();
+    
+    void attachQueue(LCDFrame *, uint8_t);
+    void detachQueue();
+    uint8_t poll();
+    uint8_t queued();
+    uint8_t queueSpace();
+    uint8_t highWater();
+    void clearHighWater();
+    
     #if ARDUINO >= 100
       virtual size_t write(uint8_t);
+      virtual size_t write(const uint8_t *, size_t);
     #else
       virtual void write(uint8_t);
+      virtual void write(const uint8_t *, size_t);
     #endif
+    using Print::write;
     
     void command(uint8_t);
     
+    static uint8_t resetExpander(uint8_t address);   // shared with LCDT
+    
   private:
+    void lcd_init(uint8_t);
     void lcd_send(uint8_t, uint8_t);
+    void lcd_sendData(const uint8_t *, size_t);
+    void lcd_encode(uint8_t, uint8_t, uint8_t *);
+    void lcd_fbWrite(uint8_t);
+    uint8_t lcd_glyphRows(const uint8_t *, uint8_t *);
+    void lcd_resetNibble(uint8_t, uint16_t);
+    int lcd_readRegister(uint8_t);
+    uint8_t lcd_writeRegister(uint8_t, uint8_t);
+    bool lcd_verifyBus();
+    uint32_t lcd_applyClock(uint32_t);
+    bool lcd_clockDown();
+    bool lcd_configured();
+    uint8_t lcd_buttonConfig();
     void lcd_burstBits(uint8_t);
+    bool lcd_burstBytes(const uint8_t *, uint8_t);
+    void lcd_busBegin();
+    void lcd_countError(uint8_t);
+    void lcd_degrade();
+    bool lcd_probe();
+    void lcd_recover();
+    void lcd_recovered();
+    void lcd_initStart();
+    bool lcd_initStep();
+    void lcd_statSend(unsigned long);
+    void lcd_queueFrame(const uint8_t *, uint16_t);
     
     uint8_t _displayfunction;
     uint8_t _displaycontrol;
     uint8_t _displaymode;
     uint8_t _numlines,_currline;
+    uint8_t _numcols;
     uint8_t lcd_i2cAddr;
+    bool _warmStart;            // let begin() skip power-on init if the panel kept power
+    bool _warm;                 // the last begin() took the warm path
+    uint32_t _clock;            // I2C clock in Hz as programmed
+    uint32_t _clockSet;         // clock chosen with setClock(), _clock may be stepped down from it
+    
+    uint8_t _buttonMask;        // expander pins set up as buttons
+    uint8_t _buttons;           // debounced state, bit set = pressed
+    volatile bool _buttonIrq;   // the expander signalled a change, set from the ISR
+    bool _buttonPending;        // waiting for the buttons to settle
+    unsigned long _buttonAt;    // millis() of the last change
+    
+    LCDErrors _errors;
+    uint8_t _retries;
+    uint16_t _timeoutUs;
+    bool _degraded;             // dropping frames until the panel answers a probe
+    bool _resync;               // a burst may have been cut mid nibble, reset on recovery
+    unsigned long _probeAt;     // micros() of the next probe or initialization step
+    uint8_t _initStep;          // next lcd_initStep(), 0 when not initializing
+    
+    LCDStats _stats;            // only counted with LCD_STATS
+    
+    uint8_t *_fb;               // shadow screen followed by the last committed screen
+    uint8_t _fbCol, _fbRow;     // framebuffer cursor
+    uint8_t _ddramAddr;         // LCD address counter as left by flush(), 0xFF if unknown
+    
+    LCDFrame *_queue;           // transmit ring drained by poll(), NULL when synchronous
+    uint8_t _qSize, _qHead, _qCount, _qHighWater;
+    unsigned long _readyAt;     // micros() at which the LCD can take the next frame
+    uint16_t _homeUs, _execUs;  // execution time of clear/home and of every other instruction
+    
+    uint8_t _glyphs[8][8];      // bitmap resident in each CGRAM slot
+    uint8_t _glyphHash[8];
+    uint16_t _glyphUsed[8];     // _glyphTick at last use, for LRU replacement
+    uint16_t _glyphTick;
+    uint8_t _glyphValid;        // bit per slot whose contents we know
 };
  
 #endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: LCDBus.cpp
+ * Function: I2C LCD library, multi-panel scheduler
+ * Description: Round robin frame scheduling across several queued LCDs on one I2C bus.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#include "LCDBus.h"
+
+LCDBus::LCDBus() {
+	_count = 0;
+	_next = 0;
+	clearStats();
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: add
+ * Description: Put a panel under the scheduler. It should already have a queue attached; a
+ *              synchronous panel blocks as usual and the bus just never finds frames for it.
+ * Ins: the LCD
+ * Outs: false if the bus already has LCDBUS_MAX_PANELS panels
+ * ----------------------------------------------------------------------------------------------*/
+bool LCDBus::add(LCD &lcd) {
+	if (_count == LCDBUS_MAX_PANELS) return false;
+	_lcd[_count] = &lcd;
+	_frames[_count] = _waits[_count] = 0;
+	_count++;
+	return true;
+}
+
+uint8_t LCDBus::panels() {
+	return _count;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: poll
+ * Description: Give every panel one chance to send its next frame, starting one panel further
+ *              on each call so no panel is always served first. A panel still executing its last
+ *              instruction is skipped, and the bus goes to the next one instead of waiting.
+ * Ins: none
+ * Outs: frames still queued across all panels
+ * ----------------------------------------------------------------------------------------------*/
+uint16_t LCDBus::poll() {
+	uint16_t pending = 0;                        // up to LCDBUS_MAX_PANELS full queues
+	uint8_t i, panel, before, after;
+
+	for (i = 0; i < _count; i++) {
+		panel = _next + i;
+		if (panel >= _count) panel -= _count;
+
+		before = _lcd[panel]->queued();
+		if (!before) continue;
+
+		after = _lcd[panel]->poll();
+		if (after < before) _frames[panel]++;
+		else _waits[panel]++;
+		pending += after;
+	}
+
+	if (++_next >= _count) _next = 0;
+	return pending;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: flush
+ * Description: Poll until every panel's queue is empty.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCDBus::flush() {
+	while (poll()) ;
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: frames, waits
+ * Description: Per panel counters since add() or clearStats(). Every frame is one I2C
+ *              transaction of 6 bytes on the wire (address, register, four GPIO states).
+ * Ins: panel index, in the order they were added
+ * Outs: frames sent / polls that found the panel busy with a frame waiting
+ * ----------------------------------------------------------------------------------------------*/
+unsigned long LCDBus::frames(uint8_t panel) {
+	return panel < _count ? _frames[panel] : 0;
+}
+
+unsigned long LCDBus::waits(uint8_t panel) {
+	return panel < _count ? _waits[panel] : 0;
+}
+
+void LCDBus::clearStats() {
+	for (uint8_t i = 0; i < _count; i++) {
+		_frames[i] = _waits[i] = 0;
+		_lcd[i]->clearHighWater();
+	}
+	_statsStart = micros();
+}
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: printStats
+ * Description: Print a table of per panel throughput since clearStats(): frames sent, frames
+ *              per second, polls that found the panel busy and the deepest its queue has been.
+ * Ins: where to print, e.g. Serial
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+void LCDBus::printStats(Print &out) {
+	unsigned long elapsed = micros() - _statsStart;
+	unsigned long ms = elapsed / 1000;
+
+	out.print("panel frames/s frames waits high ms=");
+	out.println(ms);
+	for (uint8_t i = 0; i < _count; i++) {
+		out.print(i);
+		out.print(' ');
+		out.print(ms ? _frames[i] * 1000.0 / ms : 0, 0);   // _frames * 1000 overflows 32 bits
+		out.print(' ');
+		out.print(_frames[i]);
+		out.print(' ');
+		out.print(_waits[i]);
+		out.print(' ');
+		out.println(_lcd[i]->highWater());
+	}
+}
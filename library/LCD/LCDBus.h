@@ -0,0 +1,52 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: LCDBus.h
+ * Function: I2C LCD library, multi-panel scheduler
+ * Description: Drives several queued LCDs on one I2C bus. Each panel draws into its own frame
+ *              queue (LCD::attachQueue()) without blocking, and LCDBus::poll() sends frames
+ *              round robin to whichever panels are ready, so one panel's clear or home runs
+ *              while the others are being written.
+ *
+ *                LCD zone1(0), zone2(1);
+ *                LCDFrame q1[32], q2[32];
+ *                LCDBus bus;
+ *
+ *                zone1.begin(20, 4); zone1.attachQueue(q1, 32); bus.add(zone1);
+ *                zone2.begin(20, 4); zone2.attachQueue(q2, 32); bus.add(zone2);
+ *                ...
+ *                bus.poll();   // from loop()
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef LCDBus_h
+#define LCDBus_h
+
+#include "LCD.h"
+
+// the MCP23008 has 3 address pins
+#define LCDBUS_MAX_PANELS 8
+
+class LCDBus {
+  public:
+    LCDBus();
+    
+    bool add(LCD &);
+    uint8_t panels();
+    
+    uint16_t poll();
+    void flush();
+    
+    unsigned long frames(uint8_t panel);
+    unsigned long waits(uint8_t panel);
+    void clearStats();
+    void printStats(Print &);
+    
+  private:
+    LCD *_lcd[LCDBUS_MAX_PANELS];
+    unsigned long _frames[LCDBUS_MAX_PANELS];  // frames sent to each panel
+    unsigned long _waits[LCDBUS_MAX_PANELS];   // polls that found the panel still executing
+    unsigned long _statsStart;                 // micros() at clearStats()
+    uint8_t _count;
+    uint8_t _next;                             // panel served first on the next poll()
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*-----------------------------------------------------------------------------------------------
+ * File: LCDT.h
+ * Function: I2C LCD library, compile-time specialized variant
+ * Description: LCDT<COLS, ROWS, PINS> drives the same MCP23008 + HD44780 pairing as LCD, with
+ *              the geometry and expander wiring fixed at compile time. Row offsets, nibble
+ *              placement and the backlight/RS/EN bits are enum constants, so the encoder has no
+ *              branches and setCursor() with constant arguments folds to a single command.
+ *              It is the lean write path: no framebuffer, queue, glyph cache or clock
+ *              negotiation. A failed transfer is counted and dropped, never retried.
+ *
+ *                LCDT<20, 4> lcd;                     // Hobbybotics wiring
+ *                LCDT<16, 2, MyWiring> other(1);      // another board at address 1
+ *
+ *              A pin map names the expander bit (0-7) each LCD signal is wired to:
+ *
+ *                struct MyWiring {
+ *                  enum { RS = 7, EN = 6, D4 = 0, D5 = 1, D6 = 2, D7 = 3, LT = 4 };
+ *                };
+ *
+ *              Set LT to LCDT_NO_BACKLIGHT if the board has no backlight switch.
+ * Released into the public domain.
+ * ----------------------------------------------------------------------------------------------*/
+
+#ifndef LCDT_h
+#define LCDT_h
+
+#include "LCD.h"
+#include <Wire.h>
+
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 32
+#endif
+
+#define LCDT_NO_BACKLIGHT 8
+
+// the Hobbybotics board: LT D7 D6 D5 D4 EN RS n/c
+struct LCDPinsHobbybotics {
+  enum { RS = 1, EN = 2, D4 = 3, D5 = 4, D6 = 5, D7 = 6, LT = 7 };
+};
+
+template <uint8_t COLS, uint8_t ROWS, class PINS = LCDPinsHobbybotics>
+class LCDT : public Print {
+  public:
+    enum {
+      RS_BIT = 1 << PINS::RS,
+      EN_BIT = 1 << PINS::EN,
+      LT_BIT = PINS::LT < 8 ? 1 << PINS::LT : 0,
+
+      // D4-D7 on consecutive ascending pins let a nibble be placed with one shift
+      CONTIGUOUS = PINS::D5 == PINS::D4 + 1 && PINS::D6 == PINS::D4 + 2 && PINS::D7 == PINS::D4 + 3,
+
+      // characters per I2C transaction, after the register byte
+      BURST_CHARS = (BUFFER_LENGTH - 1) / 4,
+
+      FUNCTION = LCD_FUNCTIONSET | LCD_4BITMODE | (ROWS > 1 ? LCD_2LINE : LCD_1LINE) | LCD_5x8DOTS
+    };
+
+    LCDT(uint8_t i2cAddr = 0) {
+      _address = MCP23008_ADDRESS | i2cAddr;
+      _backlight = LT_BIT;
+      _control = LCD_DISPLAYON;
+      _readyAt = 0;
+      _errors = 0;
+    }
+
+    void begin();
+
+    void clear() { command(LCD_CLEARDISPLAY); }
+    void home() { command(LCD_RETURNHOME); }
+
+    // rows 1 and 3 start at 0x40, rows 2 and 3 carry on COLS characters after rows 0 and 1
+    static uint8_t rowOffset(uint8_t row) {
+      return ((row & 1) << 6) + ((row >> 1) & 1) * COLS;
+    }
+
+    void setCursor(uint8_t col, uint8_t row) {
+      if (row >= ROWS) row = ROWS - 1;    // as LCD::setCursor()
+      command(LCD_SETDDRAMADDR | (col + rowOffset(row)));
+    }
+
+    void display() { _control |= LCD_DISPLAYON; command(LCD_DISPLAYCONTROL | _control); }
+    void noDisplay() { _control &= ~LCD_DISPLAYON; command(LCD_DISPLAYCONTROL | _control); }
+    void cursor() { _control |= LCD_CURSORON; command(LCD_DISPLAYCONTROL | _control); }
+    void noCursor() { _control &= ~LCD_CURSORON; command(LCD_DISPLAYCONTROL | _control); }
+    void blink() { _control |= LCD_BLINKON; command(LCD_DISPLAYCONTROL | _control); }
+    void noBlink() { _control &= ~LCD_BLINKON; command(LCD_DISPLAYCONTROL | _control); }
+
+    void setBacklight(uint8_t status) {
+      _backlight = status ? LT_BIT : 0;
+      burst(&_backlight, 1);
+    }
+
+    void createChar(uint8_t location, const uint8_t charmap[]) {
+      command(LCD_SETCGRAMADDR | ((location & 0x7) << 3));
+      write(charmap, 8);
+    }
+
+    void command(uint8_t value) {
+      uint8_t buf[4];
+
+      encode(value, 0, buf);
+      send(buf, 4, value < 4 ? LCD_HOME_US : LCD_EXEC_US);
+    }
+
+    #if ARDUINO >= 100
+      virtual size_t write(uint8_t value) {
+        writeData(&value, 1);
+        return 1;
+      }
+      virtual size_t write(const uint8_t *buffer, size_t size) {
+        writeData(buffer, size);
+        return size;
+      }
+    #else
+      virtual void write(uint8_t value) { writeData(&value, 1); }
+      virtual void write(const uint8_t *buffer, size_t size) { writeData(buffer, size); }
+    #endif
+    using Print::write;
+
+    unsigned long errors() { return _errors; }
+
+  private:
+    // a nibble on the D4-D7 pins
+    static uint8_t nibble(uint8_t n) {
+      if (CONTIGUOUS) return (n & 0x0F) << PINS::D4;
+      return ((n & 1) << PINS::D4) | (((n >> 1) & 1) << PINS::D5) |
+             (((n >> 2) & 1) << PINS::D6) | (((n >> 3) & 1) << PINS::D7);
+    }
+
+    // the four GPIO states that clock one byte in: high nibble, then low, EN falling on each
+    void encode(uint8_t value, uint8_t rs, uint8_t *buf) {
+      uint8_t ctrl = rs | _backlight | EN_BIT;
+
+      buf[0] = nibble(value >> 4) | ctrl;
+      buf[1] = buf[0] & ~EN_BIT;
+      buf[2] = nibble(value) | ctrl;
+      buf[3] = buf[2] & ~EN_BIT;
+    }
+
+    void writeData(const uint8_t *values, size_t count) {
+      uint8_t buf[BURST_CHARS * 4];
+      uint8_t n;
+
+      while (count) {
+        for (n = 0; count && n < BURST_CHARS; n++, count--) encode(*values++, RS_BIT, &buf[n * 4]);
+        send(buf, n * 4, LCD_EXEC_US);
+      }
+    }
+
+    void resetNibble(uint8_t n, uint16_t wait) {
+      uint8_t buf[2];
+
+      buf[0] = nibble(n) | _backlight | EN_BIT;
+      buf[1] = buf[0] & ~EN_BIT;
+      send(buf, 2, wait);
+    }
+
+    // wait out the last instruction, burst, and note when this one will be done
+    void send(const uint8_t *buf, uint8_t count, uint16_t wait) {
+      while ((long)(micros() - _readyAt) < 0) ;
+      burst(buf, count);
+      _readyAt = micros() + wait;
+    }
+
+    void burst(const uint8_t *values, uint8_t count) {
+      Wire.beginTransmission(_address);
+    #if ARDUINO >= 100
+      Wire.write((uint8_t)MCP23008_GPIO);
+      while (count--) Wire.write(*values++);
+    #else
+      Wire.send(MCP23008_GPIO);
+      while (count--) Wire.send(*values++);
+    #endif
+      if (Wire.endTransmission()) _errors++;
+    }
+
+    void writeRegister(uint8_t reg, uint8_t value) {
+      Wire.beginTransmission(_address);
+    #if ARDUINO >= 100
+      Wire.write(reg);
+      Wire.write(value);
+    #else
+      Wire.send(reg);
+      Wire.send(value);
+    #endif
+      if (Wire.endTransmission()) _errors++;
+    }
+
+    uint8_t _address;
+    uint8_t _backlight;         // LT_BIT or 0
+    uint8_t _control;           // display control flags
+    unsigned long _readyAt;     // micros() at which the LCD can take the next instruction
+    unsigned long _errors;      // transfers the expander didn't take
+};
+
+/*-----------------------------------------------------------------------------------------------
+ * Function: begin
+ * Description: Reset and configure the expander and run the HD44780 software reset into 4 bit
+ *              mode, as LCD::begin() does, then clear the screen and turn the backlight on.
+ * Ins: none
+ * Outs: none
+ * ----------------------------------------------------------------------------------------------*/
+template <uint8_t COLS, uint8_t ROWS, class PINS>
+void LCDT<COLS, ROWS, PINS>::begin() {
+  // at least 40ms after power rises above 2.7V
+  delay(50);
+
+  Wire.begin();
+  LCD::resetExpander(_address);                          // same clean slate as LCD::begin()
+  writeRegister(MCP23008_IODIR, 0x00);                   // all output
+  writeRegister(MCP23008_IOCON, MCP23008_IOCON_SEQOP);   // multi-byte writes stay on GPIO
+
+  resetNibble(0x3, LCD_RESET1_US);
+  resetNibble(0x3, LCD_RESET2_US);
+  resetNibble(0x3, LCD_EXEC_US);
+  resetNibble(0x2, LCD_EXEC_US);                         // 4 bit mode
+
+  command(FUNCTION);
+  display();
+  clear();
+  command(LCD_ENTRYMODESET | LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT);
+  setBacklight(HIGH);
+}
+
+#endif
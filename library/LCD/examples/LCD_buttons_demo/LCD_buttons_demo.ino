@@ -0,0 +1,41 @@
+/*
+ Demonstration sketch for a button on the spare MCP23008 pin of the I2C LCD.
+ 
+ Wire a push button between GP0 of the expander and ground, and the expander's
+ INT pin to Arduino pin 2 (interrupt 0). The expander's pull-up holds GP0 high
+ and raises INT when the button moves, so the sketch only talks to the
+ expander when the button is pressed or released, never just to check.
+*/
+
+#include <LCD.h>
+#include <Wire.h>
+
+// Default I2C address for LCD is 0
+LCD lcd;
+
+unsigned int presses = 0;
+
+void onButton() {
+  lcd.buttonInterrupt();
+}
+
+void setup() {
+  lcd.setButtons(LCD_BUTTON_PINS);  // before begin(), see setWarmStart()
+  lcd.begin(20, 4);
+  lcd.print("Press the button");
+  attachInterrupt(0, onButton, FALLING);
+}
+
+void loop() {
+  if (lcd.pollButtons() & 0x01) {
+    lcd.setCursor(0, 1);
+    if (lcd.buttons() & 0x01) {
+      presses++;
+      lcd.print("Down ");
+    }
+    else {
+      lcd.print("Up   ");
+    }
+    lcd.print(presses);
+  }
+}
@@ -1,10 +1,17 @@
 /*
  Benchmark sketch for I2C LCD functionality using MCP23008 I2C expander.
 
- Times how long it takes to write 47 characters (the estimated amount
- of off-screen characters on a 20x4 LCD) to the display under various
- i2c clock rates.
- 
+ At startup the library sweeps the i2c clock rates it supports, filling the
+ screen at each one, and prints a throughput table to the serial monitor.
+ It then picks the fastest clock the expander reliably answers at.
+
+ The loop times how long it takes to write 47 characters (the estimated amount
+ of off-screen characters on a 20x4 LCD) at the original 100kHz, twice: once
+ through the library's burst path (one I2C transaction per character) and once
+ through the old per-nibble path (four I2C transactions per character) so
+ the two can be compared. The burst path is then timed again at the
+ negotiated clock, and reported separately.
+
  Written to demonstrate the performance of the modified pure I2C LCD
  library by FalconFour ( http://falconfour.com ).
 */
@@ -16,37 +23,89 @@
 LCD lcd;
 
 byte digit = 0;
-unsigned long freqMult = 0;
+uint32_t negotiated;
+
+// Old lcd_send: one transaction per GPIO state, four per character
+void legacy_burst(byte value) {
+  Wire.beginTransmission(MCP23008_ADDRESS);
+  Wire.write((byte)MCP23008_GPIO);
+  Wire.write(value);
+  Wire.endTransmission();  // no retry: a missing panel mustn't hang the demo
+}
+
+void legacy_write(byte value) {
+  byte buf;
+
+  buf = ((value & B11110000) >> 1) | B10000110; // LITE, EN, RS
+  legacy_burst(buf);
+  legacy_burst(buf & ~(1<<2));
+  buf = ((value & B1111) << 3) | B10000110;
+  legacy_burst(buf);
+  legacy_burst(buf & ~(1<<2));
+}
 
 void setup() {
+  Serial.begin(9600);
   lcd.begin(20,4);
   lcd.setBacklight(true);
   lcd.clear();
   lcd.print("Performance test");
   delay(1000);
+
+  lcd.clockSweep(Serial);
+
+  // 800kHz is beyond the MCP23008's rating, but try it; negotiation falls back if it fails
+  negotiated = lcd.negotiateClock(800000);
+  if (!negotiated) negotiated = lcd.busClock();
   lcd.clear();
-  lcd.print("Default speed.");
+  lcd.print("Freq = ");
+  lcd.print(negotiated);
+}
+
+// time 47 characters through the burst path at the current clock
+long time_burst() {
+  long minitimer = millis();
+
+  lcd.setCursor(20,0);
+  for (byte x=0; x<47; x++) {
+    lcd.write(digit++);
+  }
+  return millis() - minitimer;
 }
 
 void loop() {
   byte x;
-  long msec = millis();
   long minitimer;
-  while (millis() - msec < 5000) {
-    minitimer = millis();
-    lcd.setCursor(20,0);
-    for (x=0; x<47; x++) {
-      lcd.write(digit++);
-    }
-    lcd.setCursor(0,1);
-    lcd.print("47 char, ");
-    lcd.print(millis() - minitimer,DEC);
-    lcd.print("msec");
+  long burst;
+  long legacy;
+  long fast;
+
+  // before and after at the same, original clock
+  lcd.setClock(100000);
+  burst = time_burst();
+
+  minitimer = millis();
+  lcd.setCursor(20,0);
+  for (x=0; x<47; x++) {
+    legacy_write(digit++);
   }
-  while (++freqMult > 16) delay(50);
-  bitSet(TWSR, TWPS0);
-  lcd.clear();
-  lcd.print("Freq = ");
-  lcd.print(12500UL * freqMult);
-  TWBR = (((F_CPU/(12500ul*freqMult))-16)/2)/4;
-}
\ No newline at end of file
+  legacy = millis() - minitimer;
+
+  lcd.setClock(negotiated);
+  fast = time_burst();
+
+  lcd.setCursor(0,1);
+  lcd.print("burst  ");
+  lcd.print(burst,DEC);
+  lcd.print("msec ");
+  lcd.setCursor(0,2);
+  lcd.print("nibble ");
+  lcd.print(legacy,DEC);
+  lcd.print("msec ");
+  lcd.setCursor(0,3);
+  lcd.print("burst@");
+  lcd.print(negotiated / 1000);
+  lcd.print("k ");
+  lcd.print(fast,DEC);
+  lcd.print("msec ");
+}
@@ -0,0 +1,60 @@
+/*
+ Demonstration sketch for several I2C LCDs on one bus using MCP23008 I2C expanders.
+ 
+ Two panels, at addresses 0 and 1 (set with the address jumpers), each get a frame
+ queue and are handed to an LCDBus. Drawing never blocks; bus.poll() in loop() sends
+ frames to whichever panel is ready, so one panel's clear runs while the other is
+ being written. Throughput per panel is printed to the serial monitor every 5 seconds.
+*/
+
+#include <LCD.h>
+#include <LCDBus.h>
+#include <Wire.h>
+
+LCD zone1(0);
+LCD zone2(1);
+
+LCDFrame queue1[40];
+LCDFrame queue2[40];
+
+LCDBus bus;
+
+unsigned long lastDraw = 0;
+unsigned long lastStats = 0;
+
+void setup() {
+  Serial.begin(9600);
+  
+  zone1.begin(20, 4);
+  zone1.attachQueue(queue1, 40);
+  bus.add(zone1);
+  
+  zone2.begin(20, 4);
+  zone2.attachQueue(queue2, 40);
+  bus.add(zone2);
+}
+
+void loop() {
+  bus.poll();
+  
+  // redraw both panels twice a second, only once the last redraw is out
+  if (millis() - lastDraw >= 500 && !zone1.queued() && !zone2.queued()) {
+    lastDraw = millis();
+    
+    zone1.clear();
+    zone1.print("Zone 1");
+    zone1.setCursor(0, 1);
+    zone1.print(millis() / 1000);
+    
+    zone2.clear();
+    zone2.print("Zone 2");
+    zone2.setCursor(0, 1);
+    zone2.print(millis() / 100);
+  }
+  
+  if (millis() - lastStats >= 5000) {
+    lastStats = millis();
+    bus.printStats(Serial);
+    bus.clearStats();
+  }
+}
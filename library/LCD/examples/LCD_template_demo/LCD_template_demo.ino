@@ -0,0 +1,28 @@
+/*
+ Demonstration sketch for the compile-time specialized I2C LCD driver.
+ 
+ LCDT<20, 4> knows the display size and the expander wiring at compile time,
+ so setCursor() with constant arguments and every character write compile to
+ a few instructions. It prints "Hello World!" and the elapsed time, like
+ LCD_helloworld_i2c_demo.
+ 
+ For a board wired differently from the Hobbybotics one, describe the wiring
+ in a pin map and pass it as the third template argument, see LCDT.h.
+*/
+
+#include <LCDT.h>
+#include <Wire.h>
+
+// 20x4 display, Hobbybotics wiring, I2C address 0
+LCDT<20, 4> lcd;
+
+void setup() {
+  lcd.begin();
+  lcd.print("hello, world!");
+}
+
+void loop() {
+  lcd.setCursor(0, 1);
+  lcd.print(millis()/1000);
+  delay(500);
+}